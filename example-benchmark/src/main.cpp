@@ -0,0 +1,9 @@
+#include "testApp.h"
+#include "ofAppGLFWWindow.h"
+
+int main() {
+	ofAppGLFWWindow window;
+	ofSetupOpenGL(&window, 1024, 400, OF_WINDOW);
+	ofRunApp(new testApp());
+
+}
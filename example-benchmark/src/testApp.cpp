@@ -0,0 +1,193 @@
+#include "testApp.h"
+
+// Number of repetitions for each timed operation.
+const int repetitions = 200;
+
+// Residual evaluation as it was done before ofxReprojectionLMModel: matrices
+// built with cv::Mat for every point, and three residuals per point.
+const cv::Mat legacy_affinerow = (cv::Mat_<double>(1,4) << 0,0,0,1);
+
+void legacy_evaluate_camera_matrix(const double *par, int m_dat, const void *data, double *fvec, int *info) {
+	cv::Mat A;
+	cv::Mat inputmatrix = cv::Mat(2,4,CV_64F, (void*)par);
+	cv::vconcat(inputmatrix,legacy_affinerow,A);
+
+	vector<void*> *datasets = (vector<void*>*)data;
+
+	vector< cv::Point3f > *data_cam       = (vector< cv::Point3f >*)(*datasets)[0];
+	vector< cv::Point2f > *data_projector = (vector< cv::Point2f >*)(*datasets)[1];
+
+	for(int i = 0; i < m_dat/3; i++) {
+		cv::Point3f x_data = (*data_cam)[i];
+		cv::Mat x = (cv::Mat_<double>(4,1) << x_data.x, x_data.y, x_data.z, 1);
+
+		cv::Mat b = A*x;
+
+		cv::Point2f y_data = (*data_projector)[i];
+		cv::Mat y = (cv::Mat_<double>(3,1) << y_data.x, y_data.y, 1);
+
+		fvec[3*i + 0] = b.at<double>(0,0) - y.at<double>(0,0);
+		fvec[3*i + 1] = b.at<double>(1,0) - y.at<double>(1,0);
+		fvec[3*i + 2] = b.at<double>(2,0) - y.at<double>(2,0);
+	}
+}
+
+// Forward difference Jacobian, the way lmmin calculates it without lmmin_der.
+void legacy_jacobian(double *par, int m_dat, const void *data, double *fvec, double *wa, double *fjac) {
+	int info = 0;
+	double eps = sqrt(MAX(lm_control_double.epsilon, 1e-16));
+
+	legacy_evaluate_camera_matrix(par, m_dat, data, fvec, &info);
+	for(int j = 0; j < 8; j++) {
+		double temp = par[j];
+		double step = MAX(eps*eps, eps*fabs(temp));
+		par[j] = temp + step;
+		legacy_evaluate_camera_matrix(par, m_dat, data, wa, &info);
+		for(int i = 0; i < m_dat; i++) {
+			fjac[j*m_dat + i] = (wa[i] - fvec[i]) / step;
+		}
+		par[j] = temp;
+	}
+}
+
+string formatResult(string name, unsigned long long legacy_us, unsigned long long new_us, int n) {
+	ostringstream msg;
+	msg << name << ": " << (double)legacy_us/n << " us (old), " << (double)new_us/n << " us (new), "
+		<< (new_us > 0 ? (double)legacy_us/new_us : 0) << "x";
+	return msg.str();
+}
+
+void testApp::setup(){
+	ofSetLogLevel(OF_LOG_NOTICE);
+
+	dataset.loadFile("exampleCalibrationData.xml");
+
+	runBenchmarks();
+}
+
+void testApp::runBenchmarks() {
+	results.clear();
+
+	vector<ofVec3f> measurements_all;
+	vector<ofVec2f> projpoints_all;
+	for(uint i = 0; i < dataset.getCamPoints().size(); i++) {
+		measurements_all.insert(measurements_all.end(), dataset.getCamPoints()[i].begin(), dataset.getCamPoints()[i].end());
+		projpoints_all.insert(projpoints_all.end(), dataset.getProjectorPoints()[i].begin(), dataset.getProjectorPoints()[i].end());
+	}
+
+	int num_points = MIN(measurements_all.size(), projpoints_all.size());
+	if(num_points < 4) {
+		ofLogWarning("ofxReprojection") << "Benchmark needs calibration data in exampleCalibrationData.xml";
+		return;
+	}
+
+	ostringstream header;
+	header << "Points: " << num_points << ", repetitions: " << repetitions;
+	results.push_back(header.str());
+
+	vector<void*> legacy_data;
+	legacy_data.push_back((void*) &(measurements_all));
+	legacy_data.push_back((void*) &(projpoints_all));
+	int legacy_m = 3*num_points;
+
+	ofxReprojectionLMModel model;
+	model.add(measurements_all, projpoints_all);
+	int m = model.getNumResiduals();
+
+	double start_params[2*4] = {
+		0.5,	0.5,	0.5, 0.1,
+		0.5,	0.5,	0.5, 0.1};
+
+	vector<double> fvec(legacy_m), wa(legacy_m), fjac(8*legacy_m);
+	double par[2*4];
+	int info = 0;
+
+	// Residuals.
+	copy(start_params, start_params+8, par);
+	unsigned long long t0 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		legacy_evaluate_camera_matrix(par, legacy_m, &legacy_data, &fvec[0], &info);
+	}
+	unsigned long long t1 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		ofxReprojectionLMModel::evaluate(par, m, &model, &fvec[0], &info);
+	}
+	unsigned long long t2 = ofGetElapsedTimeMicros();
+	results.push_back(formatResult("LM residuals", t1-t0, t2-t1, repetitions));
+
+	// Jacobian, i.e. the cost of one LM iteration apart from the QR factorization.
+	t0 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		legacy_jacobian(par, legacy_m, &legacy_data, &fvec[0], &wa[0], &fjac[0]);
+	}
+	t1 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		ofxReprojectionLMModel::evaluate(par, m, &model, &fvec[0], &info);
+		ofxReprojectionLMModel::jacobian(par, m, &model, &fjac[0], &info);
+	}
+	t2 = ofGetElapsedTimeMicros();
+	results.push_back(formatResult("LM Jacobian", t1-t0, t2-t1, repetitions));
+
+	// Complete fits from the old starting parameters.
+	lm_control_struct lm_control = lm_control_double;
+	lm_status_struct legacy_status, status;
+	double legacy_par[2*4];
+
+	t0 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		copy(start_params, start_params+8, legacy_par);
+		lmmin(8, legacy_par, legacy_m, &legacy_data, legacy_evaluate_camera_matrix,
+			&lm_control, &legacy_status, NULL);
+	}
+	t1 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		copy(start_params, start_params+8, par);
+		lmmin_der(8, par, m, &model, ofxReprojectionLMModel::evaluate, ofxReprojectionLMModel::jacobian,
+			&lm_control, &status, NULL);
+	}
+	t2 = ofGetElapsedTimeMicros();
+	results.push_back(formatResult("LM fit", t1-t0, t2-t1, repetitions));
+
+	ostringstream fits;
+	fits << "LM fit evaluations: " << legacy_status.nfev << " (old), " << status.nfev << " (new). "
+		<< "RMS error: " << legacy_status.fnorm/sqrt((double)num_points) << " (old), "
+		<< status.fnorm/sqrt((double)num_points) << " (new)";
+	results.push_back(fits.str());
+
+	// Direct solution, for reference.
+	t0 = ofGetElapsedTimeMicros();
+	for(int k = 0; k < repetitions; k++) {
+		ofxReprojectionNormalEquations normal_equations;
+		normal_equations.add(measurements_all, projpoints_all);
+		normal_equations.solve(par);
+	}
+	t1 = ofGetElapsedTimeMicros();
+	ostringstream direct;
+	direct << "Direct solution (normal equations): " << (double)(t1-t0)/repetitions << " us";
+	results.push_back(direct.str());
+
+	for(uint i = 0; i < results.size(); i++) {
+		ofLogNotice("ofxReprojection") << results[i];
+	}
+}
+
+void testApp::update(){
+}
+
+void testApp::draw(){
+	ofBackground(0);
+	ofSetColor(255);
+	for(uint i = 0; i < results.size(); i++) {
+		ofDrawBitmapString(results[i], 20, 30 + 20*i);
+	}
+	ofDrawBitmapString("Press space to run again.", 20, 30 + 20*(results.size()+1));
+}
+
+void testApp::keyPressed(int key){
+	if(key == ' ') {
+		runBenchmarks();
+	}
+}
+
+void testApp::exit(){
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxReprojection.h"
+
+
+class testApp : public ofBaseApp {
+public:
+	void setup();
+	void update();
+	void draw();
+	void keyPressed(int key);
+	void exit();
+
+	void runBenchmarks();
+
+	ofxReprojectionCalibrationData dataset;
+	vector<string> results;
+
+};
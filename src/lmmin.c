@@ -148,9 +148,25 @@ void lm_printout_std( int n_par, const double *par, int m_dat,
 /*  lm_minimize (intermediate-level interface)                               */
 /*****************************************************************************/
 
-void lmmin( int n_par, double *par, int m_dat, const void *data, 
+static void lm_lmdif_core( int m, int n, double *x, double *fvec, double ftol,
+               double xtol, double gtol, int maxfev, double epsfcn,
+               double *diag, int mode, double factor, int *info, int *nfev,
+               double *fjac, int *ipvt, double *qtf, double *wa1,
+               double *wa2, double *wa3, double *wa4,
+               void (*evaluate) (const double *par, int m_dat, const void *data,
+                                 double *fvec, int *info),
+               void (*jacobian) (const double *par, int m_dat, const void *data,
+                                 double *fjac, int *info),
+               void (*printout) (int n_par, const double *par, int m_dat,
+                                 const void *data, const double *fvec,
+                                 int printflags, int iflag, int iter, int nfev),
+               int printflags, const void *data );
+
+static void lmmin_core( int n_par, double *par, int m_dat, const void *data, 
             void (*evaluate) (const double *par, int m_dat, const void *data,
                               double *fvec, int *info),
+            void (*jacobian) (const double *par, int m_dat, const void *data,
+                              double *fjac, int *info),
             const lm_control_struct *control, lm_status_struct *status,
             void (*printout) (int n_par, const double *par, int m_dat,
                               const void *data, const double *fvec,
@@ -190,12 +206,12 @@ void lmmin( int n_par, double *par, int m_dat, const void *data,
     status->info = 0;
 
     /* this goes through the modified legacy interface: */
-    lm_lmdif(
+    lm_lmdif_core(
         m, n, par, fvec, control->ftol, control->xtol, control->gtol,
         control->maxcall * (n+1), control->epsilon, diag,
         ( control->scale_diag ? 1 : 2 ), control->stepbound, &(status->info),
         &(status->nfev), fjac, ipvt, qtf, wa1, wa2, wa3, wa4,
-        evaluate, printout, control->printflags, data );
+        evaluate, jacobian, printout, control->printflags, data );
 
     if ( printout )
         (*printout)(
@@ -207,8 +223,34 @@ void lmmin( int n_par, double *par, int m_dat, const void *data,
 /*** clean up. ***/
     free(fvec);
 
+} /*** lmmin_core. ***/
+
+void lmmin( int n_par, double *par, int m_dat, const void *data, 
+            void (*evaluate) (const double *par, int m_dat, const void *data,
+                              double *fvec, int *info),
+            const lm_control_struct *control, lm_status_struct *status,
+            void (*printout) (int n_par, const double *par, int m_dat,
+                              const void *data, const double *fvec,
+                              int printflags, int iflag, int iter, int nfev) )
+{
+    lmmin_core( n_par, par, m_dat, data, evaluate, NULL,
+                control, status, printout );
 } /*** lmmin. ***/
 
+void lmmin_der( int n_par, double *par, int m_dat, const void *data, 
+            void (*evaluate) (const double *par, int m_dat, const void *data,
+                              double *fvec, int *info),
+            void (*jacobian) (const double *par, int m_dat, const void *data,
+                              double *fjac, int *info),
+            const lm_control_struct *control, lm_status_struct *status,
+            void (*printout) (int n_par, const double *par, int m_dat,
+                              const void *data, const double *fvec,
+                              int printflags, int iflag, int iter, int nfev) )
+{
+    lmmin_core( n_par, par, m_dat, data, evaluate, jacobian,
+                control, status, printout );
+} /*** lmmin_der. ***/
+
 
 /*****************************************************************************/
 /*  lm_lmdif (low-level, modified legacy interface for full control)         */
@@ -238,6 +280,26 @@ void lm_lmdif( int m, int n, double *x, double *fvec, double ftol,
                                  const void *data, const double *fvec,
                                  int printflags, int iflag, int iter, int nfev),
                int printflags, const void *data )
+{
+    lm_lmdif_core( m, n, x, fvec, ftol, xtol, gtol, maxfev, epsfcn,
+                   diag, mode, factor, info, nfev, fjac, ipvt, qtf,
+                   wa1, wa2, wa3, wa4, evaluate, NULL, printout,
+                   printflags, data );
+} /*** lm_lmdif. ***/
+
+static void lm_lmdif_core( int m, int n, double *x, double *fvec, double ftol,
+               double xtol, double gtol, int maxfev, double epsfcn,
+               double *diag, int mode, double factor, int *info, int *nfev,
+               double *fjac, int *ipvt, double *qtf, double *wa1,
+               double *wa2, double *wa3, double *wa4,
+               void (*evaluate) (const double *par, int m_dat, const void *data,
+                                 double *fvec, int *info),
+               void (*jacobian) (const double *par, int m_dat, const void *data,
+                                 double *fjac, int *info),
+               void (*printout) (int n_par, const double *par, int m_dat,
+                                 const void *data, const double *fvec,
+                                 int printflags, int iflag, int iter, int nfev),
+               int printflags, const void *data )
 {
 /*
  *   The purpose of lmdif is to minimize the sum of the squares of
@@ -448,20 +510,28 @@ void lm_lmdif( int m, int n, double *x, double *fvec, double ftol,
 
 /*** outer: calculate the Jacobian. ***/
 
-        for (j = 0; j < n; j++) {
-            temp = x[j];
-            step = MAX(eps*eps, eps * fabs(temp));
-            x[j] = temp + step; /* replace temporarily */
+        if (jacobian) {
+            /* analytic Jacobian supplied by the user (lmmin_der) */
             *info = 0;
-            (*evaluate) (x, m, data, wa4, info);
-            ++(*nfev);
-            if( printout )
-                (*printout) (n, x, m, data, wa4, printflags, 1, iter, *nfev);
+            (*jacobian) (x, m, data, fjac, info);
             if (*info < 0)
                 return; /* user requested break */
-            for (i = 0; i < m; i++)
-                fjac[j*m+i] = (wa4[i] - fvec[i]) / step;
-            x[j] = temp; /* restore */
+        } else {
+            for (j = 0; j < n; j++) {
+                temp = x[j];
+                step = MAX(eps*eps, eps * fabs(temp));
+                x[j] = temp + step; /* replace temporarily */
+                *info = 0;
+                (*evaluate) (x, m, data, wa4, info);
+                ++(*nfev);
+                if( printout )
+                    (*printout) (n, x, m, data, wa4, printflags, 1, iter, *nfev);
+                if (*info < 0)
+                    return; /* user requested break */
+                for (i = 0; i < m; i++)
+                    fjac[j*m+i] = (wa4[i] - fvec[i]) / step;
+                x[j] = temp; /* restore */
+            }
         }
 #ifdef LMFIT_DEBUG_MATRIX
         /* print the entire matrix */
@@ -686,7 +756,7 @@ void lm_lmdif( int m, int n, double *x, double *fvec, double ftol,
 
     } while (1);
 
-} /*** lm_lmdif. ***/
+} /*** lm_lmdif_core. ***/
 
 
 /*****************************************************************************/
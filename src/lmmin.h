@@ -62,6 +62,19 @@ void lmmin( int n_par, double *par, int m_dat, const void *data,
                               const void *data, const double *fvec,
                               int printflags, int iflag, int iter, int nfev) );
 
+/* The same minimization, with the Jacobian calculated by the user-supplied
+   routine *jacobian instead of by forward differences. fjac is column major:
+   fjac[j*m_dat+i] is the derivative of fvec[i] with respect to par[j]. */
+void lmmin_der( int n_par, double *par, int m_dat, const void *data, 
+            void (*evaluate) (const double *par, int m_dat, const void *data,
+                              double *fvec, int *info),
+            void (*jacobian) (const double *par, int m_dat, const void *data,
+                              double *fjac, int *info),
+            const lm_control_struct *control, lm_status_struct *status,
+            void (*printout) (int n_par, const double *par, int m_dat,
+                              const void *data, const double *fvec,
+                              int printflags, int iflag, int iter, int nfev) );
+
 
 /** Legacy low-level interface. **/
 
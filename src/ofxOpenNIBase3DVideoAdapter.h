@@ -1,32 +1,60 @@
 #include "ofxOpenNI.h"
 #include "ofxBase3DVideo.h"
+#include "ofxReprojectionRawDepthSource.h"
+#include "ofxReprojectionTimestampSource.h"
+#include "ofxReprojectionUtils.h"
 
-class ofxOpenNIBase3DVideoAdapter : public ofxBase3DVideo {
+// The float depth for getDistancePixels() is only converted from the raw
+// OpenNI depth when it is asked for, at most once per new frame. Renderers
+// that upload the raw depth (see ofxReprojectionRawDepthSource) never pay
+// for the conversion.
+//
+// The timestamps are those of the OpenNI depth and image generators, on the
+// device clock in microseconds.
+
+class ofxOpenNIBase3DVideoAdapter : public ofxBase3DVideo, public ofxReprojectionRawDepthSource,
+	public ofxReprojectionTimestampSource {
 	public:
 		ofxOpenNIBase3DVideoAdapter(ofxOpenNI &i) : ni(i) {
 			ni.setUseDepthRawPixels(true);
 			distancePixels.allocate(ni.getWidth(), ni.getHeight(), 1);
 			distancePixels.set(0);
+			bDistancePixelsDirty = false;
 		}
 
 		bool isFrameNew() { return ni.isNewFrame(); }
 		void close() { ni.stop(); }
 		unsigned char* getPixels() { return ni.getImagePixels().getPixels(); }
 		ofPixels& getPixelsRef() { return ni.getImagePixels(); }
-		void update() { 
+		void update() {
 			ni.update();
-			float* dp = distancePixels.getPixels();
-			unsigned short* rp = ni.getDepthRawPixels().getPixels();
-			for(int i = 0; i < ni.getWidth()*ni.getHeight(); i++) {
-				dp[i] = rp[i];
+			if(ni.isNewFrame()) {
+				bDistancePixelsDirty = true;
 			}
-	       	}
+		}
 
 		unsigned char* getDepthPixels() { return ni.getDepthPixels().getPixels(); }
-		float* getDistancePixels() { return distancePixels.getPixels(); }
+		float* getDistancePixels() {
+			if(bDistancePixelsDirty) {
+				ofShortPixels &raw = ni.getDepthRawPixels();
+				int width = raw.getWidth();
+				int height = raw.getHeight();
+				if(width != distancePixels.getWidth() || height != distancePixels.getHeight()) {
+					distancePixels.allocate(width, height, 1);
+				}
+				ofxReprojectionUtils::convertDepthToFloat(raw.getPixels(), distancePixels.getPixels(), width*height);
+				bDistancePixelsDirty = false;
+			}
+			return distancePixels.getPixels();
+		}
+		unsigned short* getRawDepthPixels() { return ni.getDepthRawPixels().getPixels(); }
 		ofTexture& getDepthTextureReference() { return ni.getDepthTextureReference(); }
 
+		unsigned long long getColorTimestamp() { return ni.getImageGenerator().GetTimestamp(); }
+		unsigned long long getDepthTimestamp() { return ni.getDepthGenerator().GetTimestamp(); }
+
 	private:
 		ofxOpenNI& ni;
 		ofFloatPixels distancePixels;
+		bool bDistancePixelsDirty;
 };
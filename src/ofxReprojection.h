@@ -3,8 +3,23 @@
 #include "ofMain.h"
 
 #include "ofxHighlightRects.h"
+#include "ofxReprojectionBatchCalibration.h"
 #include "ofxReprojectionCalibration.h"
 #include "ofxReprojectionCalibrationData.h"
+#include "ofxReprojectionCaptureThread.h"
+#include "ofxReprojectionChessboardDetector.h"
+#include "ofxReprojectionDepthCodec.h"
+#include "ofxReprojectionFrameSynchronizer.h"
+#include "ofxReprojectionGrid.h"
+#include "ofxReprojectionLeastSquares.h"
+#include "ofxReprojectionPlayer.h"
+#include "ofxReprojectionRawDepthSource.h"
+#include "ofxReprojectionRecorder.h"
 #include "ofxReprojectionRenderer2D.h"
+#include "ofxReprojectionRendererCPU.h"
+#include "ofxReprojectionShader.h"
+#include "ofxReprojectionStabilityBuffer.h"
+#include "ofxReprojectionStreamingTexture.h"
+#include "ofxReprojectionTimestampSource.h"
 #include "ofxReprojectionUtils.h"
 
@@ -0,0 +1,210 @@
+#include "ofxReprojectionBatchCalibration.h"
+
+#include "Poco/Environment.h"
+
+ofxReprojectionBatchCalibration::ofxReprojectionBatchCalibration() {
+	chessboardSquares = ofPoint(7,5);
+
+	numThreads = 1;
+	setNumThreads(Poco::Environment::processorCount());
+
+	player = NULL;
+	chunkBegin = 0;
+	chunkEnd = 0;
+	nextFrame = 0;
+
+	bMeasurementPause = false;
+	measurementPauseTime = 0;
+
+	numFrames = 0;
+	numChessboardFrames = 0;
+	numPausedFrames = 0;
+	numMeasurements = 0;
+	runTime = 0;
+}
+
+ofxReprojectionBatchCalibration::~ofxReprojectionBatchCalibration() {
+	setNumThreads(1);
+}
+
+void ofxReprojectionBatchCalibration::setNumThreads(int n) {
+	numThreads = MAX(n, 1);
+
+	while((int)workers.size() < numThreads - 1) {
+		Worker *worker = new Worker();
+		worker->batch = this;
+		workers.push_back(worker);
+	}
+	while((int)workers.size() > numThreads - 1) {
+		delete workers.back();
+		workers.pop_back();
+	}
+}
+
+void ofxReprojectionBatchCalibration::addChessboardArea(unsigned long long timestamp, const ofRectangle &area) {
+	ScheduleEntry entry;
+	entry.timestamp = timestamp;
+	entry.area = area;
+	schedule.insert(std::upper_bound(schedule.begin(), schedule.end(), entry), entry);
+}
+
+const ofRectangle& ofxReprojectionBatchCalibration::getChessboardArea(unsigned long long timestamp) {
+	// The last area shown at the time, or the first one for earlier frames.
+	ScheduleEntry entry;
+	entry.timestamp = timestamp;
+	vector<ScheduleEntry>::iterator it = std::upper_bound(schedule.begin(), schedule.end(), entry);
+	if(it != schedule.begin()) {
+		--it;
+	}
+	return it->area;
+}
+
+bool ofxReprojectionBatchCalibration::run(string filename, ofxReprojectionCalibrationData &data) {
+	ofxReprojectionPlayer player;
+	if(!player.load(filename)) {
+		return false;
+	}
+	return run(player, data);
+}
+
+bool ofxReprojectionBatchCalibration::run(ofxReprojectionPlayer &player, ofxReprojectionCalibrationData &data) {
+	numFrames = 0;
+	numChessboardFrames = 0;
+	numPausedFrames = 0;
+	numMeasurements = 0;
+	runTime = 0;
+
+	if(!player.isLoaded()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionBatchCalibration::run: no recording loaded.";
+		return false;
+	}
+	if(schedule.empty()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionBatchCalibration::run: no chessboard areas, see addChessboardArea().";
+		return false;
+	}
+
+	unsigned long long timeStart = ofGetElapsedTimeMicros();
+
+	this->player = &player;
+	numFrames = player.getNumFrames();
+
+	// Buffers left from another recording may point into it.
+	buffers.distance.clear();
+	for(unsigned int k = 0; k < workers.size(); k++) {
+		workers[k]->buffers.distance.clear();
+	}
+
+	cornerHistory.setup(config.num_stability_frames, (chessboardSquares.x-1)*(chessboardSquares.y-1));
+	bMeasurementPause = false;
+	measurementPauseTime = 0;
+
+	// Frames are detected in chunks of several per thread, so the threads
+	// stay busy while the time per frame varies, and merged in order after
+	// each chunk. The pause started by a measurement is known when the next
+	// chunk starts, so its frames are not searched.
+	int chunkSize = 8*numThreads;
+	unsigned long long pauseLength = (unsigned long long)config.measurement_pause_length*1000;
+
+	for(int begin = 0; begin < numFrames; begin += chunkSize) {
+		chunkBegin = begin;
+		chunkEnd = MIN(begin + chunkSize, numFrames);
+		nextFrame = chunkBegin;
+
+		results.resize(chunkEnd - chunkBegin);
+		skipped.assign(chunkEnd - chunkBegin, false);
+		for(int i = chunkBegin; bMeasurementPause && i < chunkEnd; i++) {
+			if(player.getTimestamp(i) - measurementPauseTime > pauseLength) {
+				break;
+			}
+			skipped[i - chunkBegin] = true;
+		}
+
+		int numTasks = MIN(numThreads, chunkEnd - chunkBegin);
+		for(int k = 1; k < numTasks; k++) {
+			workers[k-1]->startThread(true, false);
+		}
+		detectFrames(buffers);
+		for(int k = 1; k < numTasks; k++) {
+			workers[k-1]->waitForThread(true);
+		}
+
+		for(int i = chunkBegin; i < chunkEnd; i++) {
+			mergeFrame(i, results[i - chunkBegin], data);
+		}
+	}
+
+	this->player = NULL;
+	runTime = ofGetElapsedTimeMicros() - timeStart;
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionBatchCalibration: " << numMeasurements << " measurements from "
+		<< numFrames << " frames (" << numChessboardFrames << " with chessboard, " << numPausedFrames << " paused) in "
+		<< runTime/1000 << " ms on " << numThreads << " threads.";
+	return true;
+}
+
+void ofxReprojectionBatchCalibration::Worker::threadedFunction() {
+	batch->detectFrames(buffers);
+}
+
+void ofxReprojectionBatchCalibration::detectFrames(FrameBuffers &buffers) {
+	cv::Size boardSize((int)chessboardSquares.x-1, (int)chessboardSquares.y-1);
+
+	while(true) {
+		mutex.lock();
+		int frame = nextFrame++;
+		mutex.unlock();
+		if(frame >= chunkEnd) {
+			break;
+		}
+
+		ofxReprojectionChessboardResult &result = results[frame - chunkBegin];
+		if(skipped[frame - chunkBegin]
+				|| !player->getFrame(frame, buffers.color, buffers.depthImage, buffers.distance)) {
+			result.clear();
+			continue;
+		}
+
+		ofxReprojectionChessboardDetector::detect(buffers.color.getPixels(), buffers.distance.getPixels(),
+				buffers.color.getWidth(), buffers.color.getHeight(), boardSize, config, result);
+	}
+}
+
+void ofxReprojectionBatchCalibration::mergeFrame(int frame, ofxReprojectionChessboardResult &detection,
+		ofxReprojectionCalibrationData &data) {
+	unsigned long long timestamp = player->getTimestamp(frame);
+
+	if(bMeasurementPause && timestamp - measurementPauseTime > (unsigned long long)config.measurement_pause_length*1000) {
+		bMeasurementPause = false;
+	}
+
+	if(bMeasurementPause) {
+		detection.clear();
+		numPausedFrames++;
+	} else if(detection.chessfound) {
+		numChessboardFrames++;
+	}
+
+	bool frame_ok = detection.chessfound && detection.includes_depth && detection.planar;
+	if(!frame_ok) detection.corners_depth.clear();
+
+	cornerHistory.addFrame(detection.corners_depth);
+
+	if(!frame_ok || !cornerHistory.isFull()) {
+		return;
+	}
+
+	if(cornerHistory.getLargestVarianceXY() < config.variance_threshold_xy
+			&& cornerHistory.getLargestVarianceZ() < config.variance_threshold_z) {
+		vector<ofVec3f> measurement_mean;
+		cornerHistory.getMean(measurement_mean);
+
+		vector<ofVec2f> chessboard_points;
+		ofxReprojectionCalibration::getChessboardPoints(getChessboardArea(timestamp), chessboardSquares, chessboard_points);
+
+		data.addMeasurement(measurement_mean, chessboard_points);
+		numMeasurements++;
+
+		bMeasurementPause = true;
+		measurementPauseTime = timestamp;
+	}
+}
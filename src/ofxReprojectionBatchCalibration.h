@@ -0,0 +1,137 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxReprojectionCalibration.h"
+#include "ofxReprojectionCalibrationConfig.h"
+#include "ofxReprojectionCalibrationData.h"
+#include "ofxReprojectionChessboardDetector.h"
+#include "ofxReprojectionPlayer.h"
+#include "ofxReprojectionStabilityBuffer.h"
+
+// Runs the calibration of ofxReprojectionCalibration on a recording, without
+// a window or a camera, to try other settings of the config on an old
+// session.
+//
+// The chessboard detection, with the depth sampling and the planarity check,
+// is done for many frames at once on all cores. The results are then taken
+// in frame order through the stability buffer and the measurement pause as
+// in ofxReprojectionCalibration::update(), so the measurements do not depend
+// on the number of threads. The pause is timed by the recorded timestamps,
+// and frames within it are not searched.
+//
+// The recording does not say where the chessboard was projected. It is
+// given as a schedule of chessboard areas with the time from which each was
+// shown, e.g. from ofxReprojectionCalibration::getChessboardArea() logged
+// with the frame times while recording.
+//
+// The whole image is always searched, so the result is that of the live
+// calibration without config.use_roi_tracking and
+// config.use_threaded_detection, which only change which frames and
+// regions are searched.
+//
+
+class ofxReprojectionBatchCalibration {
+public:
+	ofxReprojectionBatchCalibration();
+	~ofxReprojectionBatchCalibration();
+
+	void setConfig(ofxReprojectionCalibrationConfig config) { this->config = config; }
+	ofxReprojectionCalibrationConfig& getConfig() { return config; }
+
+	// Number of threads for the detection, including the calling thread.
+	// Defaults to the number of cores.
+	void setNumThreads(int n);
+	int getNumThreads() { return numThreads; }
+
+	// Chessboard area shown from timestamp on, in normalized projector
+	// coordinates as in ofxReprojectionCalibration.
+	void addChessboardArea(unsigned long long timestamp, const ofRectangle &area);
+	void clearChessboardAreas() { schedule.clear(); }
+
+	void setChessboardSquares(const ofPoint &squares) { chessboardSquares = squares; }
+	ofPoint getChessboardSquares() { return chessboardSquares; }
+
+	// Run the calibration on all frames of a recording, adding the accepted
+	// measurements to data. Returns false if nothing could be run.
+	bool run(string filename, ofxReprojectionCalibrationData &data);
+	bool run(ofxReprojectionPlayer &player, ofxReprojectionCalibrationData &data);
+
+	// Statistics of the last run: frames, frames with a chessboard found,
+	// frames in the measurement pause, measurements added and the time in
+	// microseconds.
+	int getNumFrames() { return numFrames; }
+	int getNumChessboardFrames() { return numChessboardFrames; }
+	int getNumPausedFrames() { return numPausedFrames; }
+	int getNumMeasurements() { return numMeasurements; }
+	unsigned long long getRunTime() { return runTime; }
+
+private:
+	// Not copyable, the workers are owned.
+	ofxReprojectionBatchCalibration(const ofxReprojectionBatchCalibration&);
+	ofxReprojectionBatchCalibration& operator=(const ofxReprojectionBatchCalibration&);
+
+	struct ScheduleEntry {
+		unsigned long long timestamp;
+		ofRectangle area;
+
+		bool operator<(const ScheduleEntry &other) const { return timestamp < other.timestamp; }
+	};
+
+	// Pixels of a frame on one thread, owning the distance of compressed
+	// recordings.
+	struct FrameBuffers {
+		ofPixels color;
+		ofPixels depthImage;
+		ofFloatPixels distance;
+	};
+
+	class Worker : public ofThread {
+		public:
+			ofxReprojectionBatchCalibration *batch;
+			FrameBuffers buffers;
+
+		private:
+			void threadedFunction();
+	};
+	friend class Worker;
+
+	// Detect the chessboard in the frames of the current chunk, taking the
+	// next frame not yet taken until none is left.
+	void detectFrames(FrameBuffers &buffers);
+
+	// Take the result of a frame through the stability buffer, as
+	// ofxReprojectionCalibration::updateStabilityBuffer().
+	void mergeFrame(int frame, ofxReprojectionChessboardResult &detection, ofxReprojectionCalibrationData &data);
+
+	const ofRectangle& getChessboardArea(unsigned long long timestamp);
+
+	ofxReprojectionCalibrationConfig config;
+	ofPoint chessboardSquares;
+	vector<ScheduleEntry> schedule;
+
+	int numThreads;
+	vector<Worker*> workers;
+	FrameBuffers buffers;
+
+	// The chunk being detected, frames [chunkBegin, chunkEnd), with the
+	// results by frame minus chunkBegin. Frames in the measurement pause
+	// are marked as skipped and not searched.
+	ofxReprojectionPlayer *player;
+	int chunkBegin;
+	int chunkEnd;
+	int nextFrame;
+	ofMutex mutex;
+	vector<ofxReprojectionChessboardResult> results;
+	vector<bool> skipped;
+
+	ofxReprojectionStabilityBuffer cornerHistory;
+	bool bMeasurementPause;
+	unsigned long long measurementPauseTime;
+
+	int numFrames;
+	int numChessboardFrames;
+	int numPausedFrames;
+	int numMeasurements;
+	unsigned long long runTime;
+};
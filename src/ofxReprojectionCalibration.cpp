@@ -11,6 +11,15 @@ ofxReprojectionCalibration::ofxReprojectionCalibration() {
 
 	lastChessboards.resize(5);
 	lastChessboardIndex = 0;
+
+	rawDepthSource = NULL;
+	depthScale = 1;
+
+	measurement_pause = false;
+	measurement_pause_time = 0;
+	num_ok_frames = 0;
+	chessfound_enough_frames = false;
+	chessfound_variance_ok = false;
 }
 
 bool ofxReprojectionCalibration::init(  ofxBase3DVideo *cam,
@@ -49,11 +58,19 @@ bool ofxReprojectionCalibration::init(  ofxBase3DVideo *cam,
 	chessboardBrightness = 255;
 
 	refMaxDepth = -1;
+	framesSinceDepthRange = 0;
 
-	corner_history.resize(config.num_stability_frames);
+	corner_history.setup(config.num_stability_frames, (chessboardSquares.x-1)*(chessboardSquares.y-1));
 
 	statusMessagesImage.allocate(camWidth, camHeight, GL_RGB);
 	depthImage.allocate(camWidth, camHeight, GL_RGB);
+	colorImage.allocate(camWidth, camHeight, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE);
+	rawDepthSource = config.use_raw_depth ? dynamic_cast<ofxReprojectionRawDepthSource*>(cam) : NULL;
+	if(rawDepthSource != NULL) {
+		depthScale = ofxReprojectionUtils::allocateDepthTexture<unsigned short>(depthTexture, camWidth, camHeight);
+	} else {
+		depthScale = ofxReprojectionUtils::allocateDepthTexture<float>(depthTexture, camWidth, camHeight);
+	}
 
 	if(bUse3DView) {
 		init3DView();
@@ -65,6 +82,7 @@ bool ofxReprojectionCalibration::init(  ofxBase3DVideo *cam,
 }
 
 ofxReprojectionCalibration::~ofxReprojectionCalibration() {
+	detector.stopWorker();
 }
 
 void ofxReprojectionCalibration::setChessboardMouseControlEnabled(bool enable) {
@@ -214,41 +232,6 @@ void ofxReprojectionCalibration::saveFile() {
 	data->saveFile(filename);
 }
 
-const cv::Mat ofxReprojectionCalibration::lm_affinerow = (cv::Mat_<double>(1,4) << 0,0,0,1);
-
-void ofxReprojectionCalibration::lm_evaluate_camera_matrix(const double *par, int m_dat, const void *data, double *fvec, int *info) {
-
-	// Calculate Ax = b for each 3d measurement x
-
-	// Matrix A
-	cv::Mat A;
-	cv::Mat inputmatrix = cv::Mat(2,4,CV_64F, (void*)par);
-	cv::vconcat(inputmatrix,lm_affinerow,A);
-
-	vector<void*> *datasets = (vector<void*>*)data;
-
-	void* data_cam_voidp    = (*datasets)[0];
-	void* data_projector_voidp = (*datasets)[1];
-
-	vector< cv::Point3f > *data_cam       = (vector< cv::Point3f >*)data_cam_voidp;
-	vector< cv::Point2f > *data_projector    = (vector< cv::Point2f >*)data_projector_voidp;
-
-	for(int i = 0; i < m_dat/3; i++) { // for each measurement
-		cv::Point3f x_data = (*data_cam)[i];
-		cv::Mat x = (cv::Mat_<double>(4,1) << x_data.x, x_data.y, x_data.z, 1);
-
-		cv::Mat b = A*x;
-
-		cv::Point2f y_data = (*data_projector)[i];
-		cv::Mat y = (cv::Mat_<double>(3,1) << y_data.x, y_data.y, 1);
-
-		// Reprojection error in each dimension.
-		fvec[3*i + 0] = b.at<double>(0,0) - y.at<double>(0,0);
-		fvec[3*i + 1] = b.at<double>(1,0) - y.at<double>(1,0);
-		fvec[3*i + 2] = b.at<double>(2,0) - y.at<double>(2,0);
-	}
-}
-
 void ofxReprojectionCalibration::updateChessboard() {
 	if(!chessboardImage.isAllocated()) {
 		ofLogWarning("ofxReprojection") << "updateChessboard() called before chessboard FBO was allocated";
@@ -286,27 +269,46 @@ void ofxReprojectionCalibration::updateChessboard() {
 	ofPopStyle();
 }
 
-ofMatrix4x4 ofxReprojectionCalibration::calculateReprojectionTransform(ofxReprojectionCalibrationData &data) {
-	vector< vector< ofVec3f > > measurements = data.getCamPoints();
-	vector< vector< ofVec2f > > projpoints = data.getProjectorPoints();
+ofMatrix4x4 ofxReprojectionCalibration::calculateReprojectionTransform(ofxReprojectionCalibrationData &data, bool useLMRefinement) {
 
- 	// Put all measured points in one vector.
- 	//
- 	vector<ofVec3f> measurements_all; {
- 		for(uint i  = 0; i < measurements.size(); i++) {
- 			for(uint j = 0; j < measurements[i].size(); j++) {
- 				measurements_all.push_back(measurements[i][j]);
- 			}
- 		}
- 	}
+ 	// Calculate full 4x4 (affine) projection/camera matrix.
+ 	// Two last rows should be (0,0,0,0; 0,0,0,1), so find the
+ 	// unknown 2x4 matrix. The model is linear in the matrix elements,
+ 	// so the least squares fit is solved directly from the normal equations,
+ 	// which the data object keeps updated for each measurement.
 
- 	vector<ofVec2f> projpoints_all; {
- 		for(uint i  = 0; i < projpoints.size(); i++) {
- 			for(uint j = 0; j < projpoints[i].size(); j++) {
- 				projpoints_all.push_back(projpoints[i][j]);
- 			}
- 		}
- 	}
+	double lm_cam_params[2*4];
+
+	ofxReprojectionNormalEquations normal_equations = data.getNormalEquations();
+
+	if(!normal_equations.solve(lm_cam_params)) {
+		ofLogWarning("ofxReprojection") << "calculateReprojectionTransform(): too few points ("
+			<< normal_equations.getNumPoints() << ") to calculate the transformation.";
+		return ofMatrix4x4::newIdentityMatrix();
+	}
+
+	// The individual points are only needed for LM refinement and debug output.
+	bool debugPoints = ofGetLogLevel("ofxReprojection") <= OF_LOG_VERBOSE;
+
+	vector<ofVec3f> measurements_all;
+	vector<ofVec2f> projpoints_all;
+
+	if(useLMRefinement or debugPoints) {
+		const vector< vector< ofVec3f > > &measurements = data.getCamPoints();
+		const vector< vector< ofVec2f > > &projpoints = data.getProjectorPoints();
+
+ 		// Put all measured points in one vector.
+ 		//
+		measurements_all.reserve(normal_equations.getNumPoints());
+		for(uint i  = 0; i < measurements.size(); i++) {
+			measurements_all.insert(measurements_all.end(), measurements[i].begin(), measurements[i].end());
+		}
+
+		projpoints_all.reserve(normal_equations.getNumPoints());
+		for(uint i  = 0; i < projpoints.size(); i++) {
+			projpoints_all.insert(projpoints_all.end(), projpoints[i].begin(), projpoints[i].end());
+		}
+	}
 
  	// Transform measurement coodinates into world coordinates.
  	//
@@ -317,31 +319,23 @@ ofMatrix4x4 ofxReprojectionCalibration::calculateReprojectionTransform(ofxReproj
 	// 		// Transform projector coordinates? (not necessary)
 	// 	}
 
+ 	// Optionally refine the solution by LM least squares (lmmin.c),
+ 	// starting from the direct solution.
 
- 	// Try calculating full 4x4 (affine) projection/camera matrix
- 	// by fitting the data to a matrix by LM least squares (lmmin.c).
- 	// Two last rows should be (0,0,0,0; 0,0,0,1), so find the
- 	// unknown 2x4 matrix.
-
- 	vector<void*> lm_cam_data;
+	if(useLMRefinement) {
+		ofxReprojectionLMModel lm_cam_model;
+		lm_cam_model.add(measurements_all, projpoints_all);
 
- 	lm_cam_data.push_back((void*) &(measurements_all));
- 	lm_cam_data.push_back((void*) &(projpoints_all));
+		lm_status_struct lm_cam_status;
+		lm_control_struct lm_cam_control = lm_control_double;
+		lm_cam_control.printflags = 3;
 
- 	lm_status_struct lm_cam_status;
- 	lm_control_struct lm_cam_control = lm_control_double;
- 	lm_cam_control.printflags = 3;
+		int n_par = 2*4;
 
- 	int n_par = 2*4;
-
- 	// some temporary params.
-	double lm_cam_params[2*4] = {
-		0.5,	0.5,	0.5, 0.1,
-		0.5,	0.5,	0.5, 0.1};
-
- 	lmmin(n_par, lm_cam_params, measurements_all.size()*3, (const void*)&lm_cam_data,
- 		lm_evaluate_camera_matrix,
- 		&lm_cam_control, &lm_cam_status, NULL);
+		lmmin_der(n_par, lm_cam_params, lm_cam_model.getNumResiduals(), (const void*)&lm_cam_model,
+			ofxReprojectionLMModel::evaluate, ofxReprojectionLMModel::jacobian,
+			&lm_cam_control, &lm_cam_status, NULL);
+	}
 
  	// Copy to openFrameworks matrix type.
  	ofMatrix4x4 ofprojmat;
@@ -351,25 +345,18 @@ ofMatrix4x4 ofxReprojectionCalibration::calculateReprojectionTransform(ofxReproj
 			0,0,0,0,
  		       	0,0,0,1);
 
- 	// Calculate reprojection error.
- 	double cum_err_2 = 0;
- 	for(uint i = 0; i < measurements_all.size(); i++) {
- 		ofVec3f v(
- 				measurements_all[i].x,
- 				measurements_all[i].y,
- 				measurements_all[i].z
- 			);
+ 	// Print all measured values with reprojection, for debugging.
+	for(uint i = 0; debugPoints and i < measurements_all.size() and i < projpoints_all.size(); i++) {
  		ofVec2f projpoint = projpoints_all[i];
- 		ofVec3f u = ofprojmat*v;
+ 		ofVec3f u = ofprojmat*measurements_all[i];
  		double error = sqrt(pow(u.x-projpoint.x,2)+pow(u.y-projpoint.y,2));
 
- 		// Print all measured values with reprojection, for debugging.
  		ofLogVerbose("ofxReprojection") << "calculateReprojectionTransform() debug: " << 
 			measurements_all[i] << " " << projpoint << " " << u << " " << error ;
-
- 		cum_err_2 += error*error;
  	}
- 	double rms = sqrt(cum_err_2/ measurements_all.size() );
+
+ 	// Calculate reprojection error from the sums.
+ 	double rms = normal_equations.getRMSError(lm_cam_params);
 
  	ofLogVerbose("ofxReprojection") << "Calculated transformation:" << endl << ofprojmat;
  	ofLogVerbose("ofxReprojection") << "Calculated RMS reprojection error: " << rms;
@@ -401,312 +388,158 @@ void ofxReprojectionCalibration::update(bool forceupdate) {
 	bHasReceivedFirstFrame = true;
 
 	//
-	// TODO: separate this into a thread? findChessboardCorners can be very slow.
+	// findChessboardCorners can be very slow, so with config.use_threaded_detection
+	// the detection runs on the detector's worker thread, and the result is
+	// picked up here in a later update().
 	//
-	if(bHasReceivedFirstFrame && (forceupdate || cam->isFrameNew())) {
-		// ofLogVerbose("ofxReprojection") << "Calibration update: Updating chessboard";
-		ofxReprojectionUtils::makeHueDepthImage(cam->getDistancePixels(), camWidth, camHeight, refMaxDepth, depthImage);
-		depthFloats.setFromPixels(cam->getDistancePixels(), camWidth, camHeight, OF_IMAGE_GRAYSCALE);
-
-		// Convert color image to OpenCV image.
-		unsigned char *pPixelsUC = (unsigned char*) cam->getPixels();
-		cv::Mat chessdetectimage(camHeight, camWidth, CV_8UC(3), pPixelsUC);
+	if(config.use_threaded_detection && !detector.isWorkerRunning()) {
+		detector.startWorker();
+	} else if(!config.use_threaded_detection && detector.isWorkerRunning()) {
+		detector.stopWorker();
+	}
 
-		vector<cv::Point2f> chesscorners;
+	bool bNewFrame = bHasReceivedFirstFrame && (forceupdate || cam->isFrameNew());
+	bool bDetectionUpdated = false;
 
-		// ofLogVerbose("ofxReprojection") << "Calibration update: Converting to grayscale image";
-		cv::Mat gray;
-		cv::cvtColor(chessdetectimage, gray, CV_BGR2GRAY);
+	if(measurement_pause and (ofGetSystemTime() - measurement_pause_time > config.measurement_pause_length)) {
+		measurement_pause = false;
+	}
 
-		chessfound = false;
+	cv::Size chessboardSize = cv::Size((int)chessboardSquares.x-1,(int)chessboardSquares.y-1);
 
-		if(measurement_pause and (ofGetSystemTime() - measurement_pause_time > config.measurement_pause_length)) {
-			measurement_pause = false;
+	if(bNewFrame) {
+		if(config.auto_depth_range and ++framesSinceDepthRange >= config.auto_depth_range_interval) {
+			refMaxDepth = ofxReprojectionUtils::getRefMaxDepth(cam->getDistancePixels(), camWidth, camHeight,
+					config.auto_depth_range_percentile, depthStatistics);
+			framesSinceDepthRange = 0;
 		}
 
-
-		cv::Size chessboardSize = cv::Size((int)chessboardSquares.x-1,(int)chessboardSquares.y-1);
-
-		if(!measurement_pause) {
-			chessfound =  cv::findChessboardCorners(gray, chessboardSize, chesscorners,
-				cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_FAST_CHECK);
+		ofxReprojectionUtils::makeHueDepthImage(cam->getDistancePixels(), camWidth, camHeight, refMaxDepth, depthImage, depthImagePixels);
+		if(rawDepthSource != NULL) {
+			depthTexture.loadData(rawDepthSource->getRawDepthPixels());
+		} else {
+			depthTexture.loadData(cam->getDistancePixels());
 		}
 
-		vector<cv::Point3f> chesscorners_depth;
-
-		if(chessfound) {
-			// ofLogVerbose("ofxReprojection") << "Calibration update: Found chessboard, calc. sub-pixel coords.";
-			cv::cornerSubPix(gray, chesscorners, cv::Size(5, 5), cv::Size(-1, -1),
-				cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-
-			// Add depth data to corners found (interpolate integer z coord to match fractional x,y coords)
-
-			// Calculate matrix elements for solving planar regression (multiple linear regression)
-			// to find R^2-value of plane (how planar is the chess board?).
-			//
-			// This test is not strictly needed, but in case you are using a flat board to
-			// move around for the chessboard to be projected on, then this will be a test
-			// that can give an indication of whether the measurements are good.
-			// Can be disabled in config.use_planar_condition.
-
-			double sumX = 0;
-			double sumY = 0;
-			double sumZ = 0;
-			double sumX2 = 0;
-			double sumY2 = 0;
-			double sumXY = 0;
-			double sumYZ = 0;
-			double sumXZ = 0;
-			double n = 0;
-
-			chessfound_includes_depth = true;
-			for(uint i = 0; i < chesscorners.size(); i++) {
-				// ofLogVerbose("ofxReprojection") << "Calibration update: Found chessboard, interp z coord #" << i << ".";
-				float *pDPixel = (float*) cam->getDistancePixels();
-
-				// Calculate 3D point from color and depth image ("world coords")
-				cv::Point3f p;
-				p.x = chesscorners[i].x;
-				p.y = chesscorners[i].y;
-
-				int imgx1 = ((int) p.x);
-				int imgx2 = ((int) p.x) +1;
-
-				int imgy1 = ((int) p.y);
-				int imgy2 = ((int) p.y) +1;
-
-				// Check that all relevant depth values are valid;
-				vector<int> depth_values_test;
-				depth_values_test.push_back(imgx1+imgy1*camWidth);
-				depth_values_test.push_back(imgx1+imgy2*camWidth);
-				depth_values_test.push_back(imgx2+imgy1*camWidth);
-				depth_values_test.push_back(imgx2+imgy2*camWidth);
-
-				for(uint j = 0; j < depth_values_test.size(); j++) {
-					int value = (int)pDPixel[depth_values_test[j]];
-					if(value < config.depth_min || value > config.depth_max) {
-						chessfound_includes_depth = false;
-						break;
-					}
-				}
-
-
-
-				float interp_x1, interp_x2, interp_z;
-
-				// Bilinear interpolation to find z in depth map from fractional coords.
-				// (The detected corners have sub-pixel precision.)
-				interp_x1  = (imgx2-(float)p.x)/((float)(imgx2-imgx1))*((float)pDPixel[imgx1+imgy1*camWidth]);
-				interp_x1 += ((float)p.x-imgx1)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy1*camWidth]);
-
-				interp_x2  = (imgx2-(float)p.x)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy1*camWidth]);
-				interp_x2 += ((float)p.x-imgx1)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy2*camWidth]);
-
-				interp_z   = (imgy2-(float)p.y)/((float)(imgy2-imgy1)) * interp_x1;
-				interp_z  += ((float)p.y-imgy1)/((float)(imgy2-imgy1)) * interp_x2;
-
-				p.z = interp_z;
-
-				// Sum values for planar regression below
-				sumX += p.x;
-				sumY += p.y;
-				sumZ += p.z;
-				sumX2 += p.x*p.x;
-				sumY2 += p.y*p.y;
-				sumXY += p.x*p.y;
-				sumYZ += p.y*p.z;
-				sumXZ += p.x*p.z;
-				n += 1;
-
-				//cout << "interpolating depth value. close int: " << pDPixel[imgx1+imgy1*camWidth]
-				     //<< ", interp: " << p.z << endl;
+		unsigned char *pPixelsUC = (unsigned char*) cam->getPixels();
 
-				// ofLogVerbose("ofxReprojection") << "Calibration update: result " << p.z << ".";
-				chesscorners_depth.push_back(p);
+		if(config.use_threaded_detection) {
+			if(!measurement_pause) {
+				detector.submitFrame(pPixelsUC, cam->getDistancePixels(), camWidth, camHeight,
+						chessboardSize, config);
 			}
-
-
-			if(chessfound_includes_depth) {
-				// ofLogVerbose("ofxReprojection") << "Calibration update: checking planarity";
-				//cout << chesscorners_depth << endl;
-
-				// Solve least squares to find plane equation
-				cv::Mat lsq_left = ( cv::Mat_<double>(3,3)  << sumX2, sumXY, sumX, sumXY, sumY2, sumY, sumX, sumY, n );
-				//cout << "lsq_left: " << lsq_left << endl;
-
-				cv::Mat lsq_right = ( cv::Mat_<double>(3,1) << sumXZ, sumYZ, sumZ );
-
-				cv::Mat_<double> plane;
-
-				bool planesolved = cv::solve(lsq_left, lsq_right, plane);
-
-				plane_r2 = 0;
-				chessfound_planar = false;
-				if(planesolved) {
-
-					// Find R^2 of regression to assess planarity
-
-					double ssres = 0;
-					double sstot = 0;
-					for(uint i = 0; i < chesscorners_depth.size(); i++) {
-						double tot = chesscorners_depth[i].z-sumZ/n;
-						sstot += tot*tot;
-
-						double fz = plane(0,0)*chesscorners_depth[i].x
-							  + plane(0,1)*chesscorners_depth[i].y
-							  + plane(0,2);
-						double res = chesscorners_depth[i].z - fz;
-						ssres += res*res;
-					}
-
-					plane_r2 = 1 - ssres/sstot;
-
-					if(config.use_planar_condition) {
-						chessfound_planar = plane_r2 > config.planar_threshold;
-					} else {
-						chessfound_planar = true;
-					}
-				}
+		} else {
+			if(!measurement_pause) {
+				detector.track(pPixelsUC, cam->getDistancePixels(),
+						camWidth, camHeight, chessboardSize, config, detection);
+			} else {
+				detection.clear();
 			}
-
-			// ofLogVerbose("ofxReprojection") << "Calibration update: Drawing detected chessboard corners onto color img.";
-			cv::drawChessboardCorners(chessdetectimage, chessboardSize, cv::Mat(chesscorners), chessfound);
+			bDetectionUpdated = true;
 		}
+	}
 
-		// Convert image to ofTexture for drawing status screen.
-		// ofLogVerbose("ofxReprojection") << "Calibration update: copying color img from cv::Mat to ofTexture.";
-		colorImage.loadData(pPixelsUC, camWidth, camHeight, GL_RGB);
-		// ofLogVerbose("ofxReprojection") << "Calibration update: successfully copied to ofTexture";
-
-		// If chessboard is found, depth data exists and planarity check is satisfied,
-		// add this measurement to the stability buffer corner_history.
-
-		bool frame_ok = chessfound && chessfound_includes_depth && chessfound_planar;
-		if(!frame_ok) chesscorners_depth.clear();
-		//if(frame_ok) ofLogVerbose("ofxReprojection") << "Calibration update: adding OK frame to corner history.";
-
-		stability_buffer_i = (stability_buffer_i + 1)%(config.num_stability_frames);
-
-		corner_history[stability_buffer_i] = chesscorners_depth;
+	if(config.use_threaded_detection && detector.getResult(detection)) {
+		// Results from frames submitted before a measurement was accepted
+		// should not be counted towards the next measurement.
+		if(measurement_pause) {
+			detection.clear();
+		}
+		bDetectionUpdated = true;
+	}
 
-		// Count number of acceptable frames in stability buffer corner_history.
+	if(bNewFrame) {
+		// Convert color image to OpenCV image.
+		unsigned char *pPixelsUC = (unsigned char*) cam->getPixels();
+		cv::Mat chessdetectimage(camHeight, camWidth, CV_8UC(3), pPixelsUC);
 
-		chessfound_enough_frames = false;
-		if(frame_ok) {
-			// ofLogVerbose("ofxReprojection") << "Calibration update: counting OK frames in history";
-			num_ok_frames = 0;
-			for(uint i = 0; i < corner_history.size(); i++) {
-				if(corner_history[i].size() == chesscorners_depth.size()) {
-					num_ok_frames += 1;
-				}
-			}
-			if(num_ok_frames == config.num_stability_frames) {
-				chessfound_enough_frames = true;
-			}
+		if(detection.chessfound && !measurement_pause) {
+			cv::drawChessboardCorners(chessdetectimage, chessboardSize, cv::Mat(detection.corners), true);
 		}
 
-		// If enough consecutive acceptable frames/measurements have been found,
-		// check variance within the stability buffer corner_history.
-
+		// Convert image to ofTexture for drawing status screen.
+		colorImage.loadData(pPixelsUC);
+	}
 
-		chessfound_variance_ok = false;
-		if(chessfound_enough_frames) {
-			// ofLogVerbose("ofxReprojection") << "Calibration update: calculating/checking variance";
-			largest_variance_xy = 0;
-			largest_variance_z  = 0;
-			for(uint i = 0; i < corner_history[0].size(); i++) {
-				for(uint j = 0; j < 3; j++) {
-					double mean = 0;
-					double variance = 0;
+	if(bDetectionUpdated) {
+		updateStabilityBuffer();
+	}
 
-					for(uint k = 0; k < corner_history.size(); k++) {
-						cv::Vec<float, 3> corner_history_vector = corner_history[k][i];
-						mean += corner_history_vector[j];
-					}
-					mean /= corner_history.size();
-
-					for(uint k = 0; k < corner_history.size(); k++) {
-						cv::Vec<float, 3> corner_history_vector = corner_history[k][i];
-						double dist = corner_history_vector[j] - mean;
-						if(j == 0 or j == 1) {
-							variance += dist*dist;
-						} else if ( j== 2) {
-							variance += (dist*dist) / corner_history_vector[j];
-						}
-					}
-					variance /= corner_history.size();
+	if(bNewFrame || bDetectionUpdated) {
+		updateStatusMessages();
+	}
+}
 
-					//cout << "variance for corner #" << i << " dimension " << j << " = " << variance << endl;
+void ofxReprojectionCalibration::updateStabilityBuffer() {
+	// If chessboard is found, depth data exists and planarity check is satisfied,
+	// add this measurement to the stability buffer corner_history.
 
+	bool frame_ok = detection.chessfound && detection.includes_depth && detection.planar;
+	if(!frame_ok) detection.corners_depth.clear();
+	//if(frame_ok) ofLogVerbose("ofxReprojection") << "Calibration update: adding OK frame to corner history.";
 
-					if( (j == 0 or j == 1) and variance > largest_variance_xy) {
-						largest_variance_xy = variance;
-					}
+	if(corner_history.getCapacity() != config.num_stability_frames) {
+		corner_history.setup(config.num_stability_frames, (chessboardSquares.x-1)*(chessboardSquares.y-1));
+	}
 
-					if( j == 2 and variance > largest_variance_z) {
-						largest_variance_z = variance;
-					}
-				}
-			}
+	corner_history.addFrame(detection.corners_depth);
 
-			if(largest_variance_xy < config.variance_threshold_xy and largest_variance_z < config.variance_threshold_z) {
-				chessfound_variance_ok = true;
+	// Count number of acceptable frames in stability buffer corner_history.
 
-				// Measurement is accepted. Calculate the mean and
-				// add to valid_measurements and all_chessboard_points.
-				// Also, convert to openFrameworks vector structs.
+	chessfound_enough_frames = false;
+	if(frame_ok) {
+		num_ok_frames = corner_history.getNumOkFrames();
+		chessfound_enough_frames = corner_history.isFull();
+	}
 
-				// ofLogVerbose("ofxReprojection") << "Calibration update: variance OK, adding measurement";
+	// If enough consecutive acceptable frames/measurements have been found,
+	// check variance within the stability buffer corner_history.
 
-				vector<ofVec3f> measurement_mean;
-				for(uint i = 0; i < corner_history[0].size(); i++) {
-					cv::Vec<float, 3> corner;
-					for(uint j= 0 ; j < 3; j ++) {
-						double mean = 0;
-						for(uint k = 0; k < corner_history.size(); k++) {
-							cv::Vec<float, 3> corner_history_vector = corner_history[k][i];
-							mean += corner_history_vector[j];
-						}
-						mean /= corner_history.size();
-						corner[j] = mean;
-					}
+	chessfound_variance_ok = false;
+	if(chessfound_enough_frames) {
+		// ofLogVerbose("ofxReprojection") << "Calibration update: calculating/checking variance";
+		largest_variance_xy = corner_history.getLargestVarianceXY();
+		largest_variance_z  = corner_history.getLargestVarianceZ();
 
-					ofVec3f cornerp = ofVec3f(corner[0],corner[1],corner[2]);
-					// ofLogVerbose("ofxReprojection") << "Adding measurement corner: " << cornerp;
-					measurement_mean.push_back(cornerp);
-				}
+		if(largest_variance_xy < config.variance_threshold_xy and largest_variance_z < config.variance_threshold_z) {
+			chessfound_variance_ok = true;
 
+			// Measurement is accepted. Use the mean and
+			// add to valid_measurements and all_chessboard_points.
 
-				vector<ofVec2f> chessboard_points;
+			// ofLogVerbose("ofxReprojection") << "Calibration update: variance OK, adding measurement";
 
-				// findChessboardCorners gives row-major order corners,
-				// the loop below must match this (y is outer loop).
-				for(int y = 0; y < (int)chessboardSquares.y-1; y++) {
-					for(int x = 0; x < (int)chessboardSquares.x-1; x++) {
-						float px = chessboardArea.x + (x+1)*(chessboardArea.width/chessboardSquares.x);
-						float py = chessboardArea.y + (y+1)*(chessboardArea.height/chessboardSquares.y);
-						ofVec2f p(px,py);
+			vector<ofVec3f> measurement_mean;
+			corner_history.getMean(measurement_mean);
 
-						// ofLogVerbose("ofxReprojection") << "Adding chessboard corner: " << p;
-						chessboard_points.push_back(p);
-					}
-				}
+			vector<ofVec2f> chessboard_points;
+			getChessboardPoints(chessboardArea, chessboardSquares, chessboard_points);
 
-				data->addMeasurement(measurement_mean, chessboard_points);
+			data->addMeasurement(measurement_mean, chessboard_points);
 
-				measurement_pause = true;
-				measurement_pause_time = ofGetSystemTime();
+			measurement_pause = true;
+			measurement_pause_time = ofGetSystemTime();
 
-			}
 		}
-
-		updateStatusMessages();
 	}
+}
+
+void ofxReprojectionCalibration::getChessboardPoints(const ofRectangle &area, const ofPoint &squares, vector<ofVec2f> &points) {
+	points.clear();
 
+	// findChessboardCorners gives row-major order corners,
+	// the loop below must match this (y is outer loop).
+	for(int y = 0; y < (int)squares.y-1; y++) {
+		for(int x = 0; x < (int)squares.x-1; x++) {
+			float px = area.x + (x+1)*(area.width/squares.x);
+			float py = area.y + (y+1)*(area.height/squares.y);
+			points.push_back(ofVec2f(px,py));
+		}
+	}
 }
 
 void ofxReprojectionCalibration::drawColorImage(float x, float y, float w, float h) {
-	colorImage.draw(x,y,w,h);
+	colorImage.getTextureReference().draw(x,y,w,h);
 }
 
 void ofxReprojectionCalibration::drawDepthImage(float x, float y, float w, float h) {
@@ -756,11 +589,13 @@ void ofxReprojectionCalibration::draw3DView(float x, float y, float w, float h)
 
 	cam3DView.begin();
 
-	shader3DView.begin();
-	shader3DView.setUniformTexture("depth_map", depthFloats, 0);
-	shader3DView.setUniformTexture("color_image", colorImage, 1);
+	shader3DView->begin();
+	shader3DView->setUniformTexture("depth_map", depthTexture.getTextureReference(), 0);
+	shader3DView->setUniform1f("depth_scale", depthScale);
+	shader3DView->setUniformTexture("color_image", colorImage.getTextureReference(), 1);
+	grid3DView.setUniforms(*shader3DView);
 	grid3DView.draw();
-	shader3DView.end();
+	shader3DView->end();
 
 	glPointSize(10);
 	ofSetColor(255,0,0,255);
@@ -789,6 +624,10 @@ void ofxReprojectionCalibration::updateStatusMessages() {
 	string str = "framerate is ";
 	str += ofToString(ofGetFrameRate(), 2)+"fps";
 
+	if(config.use_threaded_detection) {
+		str += ", dropped frames " + ofToString(detector.getNumDroppedFrames());
+	}
+
 	ofDrawBitmapString(str, 20,20);
 
 	ostringstream msg; msg << "Valid measurements: " << data->getCamPoints().size();
@@ -805,6 +644,12 @@ void ofxReprojectionCalibration::updateStatusMessages() {
 					<< " Z " << config.variance_threshold_z << "." << endl;
 	ofDrawBitmapString(msg3.str(), 20, height-80);
 
+	ostringstream msg4; msg4 << "Detection in " << detection.search_area.width << "x" << detection.search_area.height
+				<< " area at 1/" << detection.pyramid_factor << " resolution:\n downscale "
+				<< detection.time_downscale/1000.0 << " ms, search " << detection.time_search/1000.0
+				<< " ms, refine " << detection.time_refine/1000.0 << " ms." << endl;
+	ofDrawBitmapString(msg4.str(), 20, height-114);
+
 	ofColor c_error(200,0,0);
 	ofColor c_success(0,200,0);
 	ofColor c_white(255,255,255);
@@ -813,27 +658,27 @@ void ofxReprojectionCalibration::updateStatusMessages() {
 		ofSetColor(c_white);
 		ofDrawBitmapString("Pausing before next measurement...", 20, 40);
 	} else {
-		if(!chessfound) {
+		if(!detection.chessfound) {
 			ofSetColor(c_error);
 			ofDrawBitmapString("Chess board not detected.",20, 40);
 		} else {
 			ofSetColor(c_success);
 			ofDrawBitmapString("Chess board detected.",20, 40);
 
-			if(!chessfound_includes_depth) {
+			if(!detection.includes_depth) {
 				ofSetColor(c_error);
 				ofDrawBitmapString("Depth data for chess board is incomplete.", 20, 60);
 			} else {
 				ofSetColor(c_success);
 				ofDrawBitmapString("Depth data complete.", 20, 60);
 
-				if(!chessfound_planar) {
+				if(!detection.planar) {
 					ofSetColor(c_error);
-					ostringstream msg; msg << "Chessboard is not planar (R^2 = " << plane_r2 << ").";
+					ostringstream msg; msg << "Chessboard is not planar (R^2 = " << detection.plane_r2 << ").";
 					ofDrawBitmapString(msg.str(), 20, 80);
 				} else {
 					ofSetColor(c_success);
-					ostringstream msg; msg << "Chessboard is planar (R^2 = " << plane_r2 << ").";
+					ostringstream msg; msg << "Chessboard is planar (R^2 = " << detection.plane_r2 << ").";
 					ofDrawBitmapString(msg.str(), 20, 80);
 
 					if(!chessfound_enough_frames) {
@@ -905,42 +750,15 @@ void ofxReprojectionCalibration::unfinalize() {
 
 void ofxReprojectionCalibration::init3DView() {
 
-	shader3DView.setupShaderFromSource(GL_VERTEX_SHADER,
-			ofxReprojectionUtils::stringVertexShaderCalibration3DView);
-	shader3DView.setupShaderFromSource(GL_FRAGMENT_SHADER,
-			ofxReprojectionUtils::stringFragmentShaderCalibration3DView);
-	shader3DView.setupShaderFromSource(GL_GEOMETRY_SHADER,
-			ofxReprojectionUtils::stringGeometryShaderCalibration3DView);
-
-	shader3DView.linkProgram();
-	shader3DView.printActiveUniforms();
-
-	shader3DView.setGeometryInputType(GL_TRIANGLES);
-	shader3DView.setGeometryOutputType(GL_TRIANGLES);
-	shader3DView.setGeometryOutputCount(3);
-
-	grid3DView.clear();
-	grid3DView.setMode(OF_PRIMITIVE_TRIANGLES);
-	int skip = 1;
-	for(int y = 0; y < camHeight - skip; y += skip) {
-		for(int x = 0; x < camWidth - skip; x += skip) {
-			grid3DView.addVertex(ofVec3f(x,y,2));
-			grid3DView.addVertex(ofVec3f(x+skip,y+skip,2));
-			grid3DView.addVertex(ofVec3f(x,y+skip,2));
-
-			grid3DView.addVertex(ofVec3f(x,y,2));
-			grid3DView.addVertex(ofVec3f(x+skip,y,2));
-			grid3DView.addVertex(ofVec3f(x+skip,y+skip,2));
-
-			grid3DView.addTexCoord(ofVec2f(x,y));
-			grid3DView.addTexCoord(ofVec2f(x+skip,y+skip));
-			grid3DView.addTexCoord(ofVec2f(x,y+skip));
-
-			grid3DView.addTexCoord(ofVec2f(x,y));
-			grid3DView.addTexCoord(ofVec2f(x+skip,y));
-			grid3DView.addTexCoord(ofVec2f(x+skip,y+skip));
-		}
-	}
+	// The grid falls back to a vertex buffer if the procedural grid is not
+	// supported, so make it first and the vertex shader to match.
+	grid3DView.setup(camWidth, camHeight, 1, OF_PRIMITIVE_TRIANGLES, config.use_procedural_grid);
+
+	shader3DView = ofxReprojectionShader::get(
+			ofxReprojectionUtils::makeVertexShader(ofxReprojectionUtils::stringVertexShaderCalibration3DViewMain,
+				grid3DView.isProcedural()),
+			ofxReprojectionUtils::stringFragmentShaderCalibration3DView,
+			ofxReprojectionUtils::stringGeometryShaderCalibration3DView, GL_TRIANGLES, GL_TRIANGLES, 3);
 }
 
 void ofxReprojectionCalibration::updatePoints3DView() {
@@ -8,6 +8,13 @@
 #include "ofxBase3DVideo.h"
 #include "ofxReprojectionCalibrationData.h"
 #include "ofxReprojectionCalibrationConfig.h"
+#include "ofxReprojectionChessboardDetector.h"
+#include "ofxReprojectionGrid.h"
+#include "ofxReprojectionLeastSquares.h"
+#include "ofxReprojectionRawDepthSource.h"
+#include "ofxReprojectionShader.h"
+#include "ofxReprojectionStreamingTexture.h"
+#include "ofxReprojectionStabilityBuffer.h"
 #include "ofxReprojectionUtils.h"
 #include "lmmin.h"
 #include "ofxEasyCamArea.h"
@@ -88,7 +95,9 @@ public:
 	void finalize();
 	void unfinalize();
 
-	static ofMatrix4x4 calculateReprojectionTransform(ofxReprojectionCalibrationData &data);
+	// Least squares fit of the reprojection matrix to the measurements. The fit is
+	// solved directly, and can optionally be refined by Levenberg-Marquardt (lmmin).
+	static ofMatrix4x4 calculateReprojectionTransform(ofxReprojectionCalibrationData &data, bool useLMRefinement = false);
 
 	void setData(ofxReprojectionCalibrationData *data) { this->data = data; update(true); }
 	ofxReprojectionCalibrationData* getData() { return data; }
@@ -98,6 +107,24 @@ public:
 
 	bool isFinalized() { return bFinalized; }
 
+	// Projected chessboard, in normalized projector coordinates. Logging the
+	// area with the time of each change gives the schedule needed to run the
+	// calibration again on a recording, see ofxReprojectionBatchCalibration.
+	ofRectangle getChessboardArea() { return chessboardArea; }
+	ofPoint getChessboardSquares() { return chessboardSquares; }
+
+	// Projector points of the inner corners of a chessboard with the given
+	// number of squares drawn in area, in the order of the detected corners.
+	static void getChessboardPoints(const ofRectangle &area, const ofPoint &squares, vector<ofVec2f> &points);
+
+	// Number of frames that were replaced by a newer frame before the
+	// detection thread got to them (only when config.use_threaded_detection is set).
+	unsigned long getNumDroppedFrames() { return detector.getNumDroppedFrames(); }
+
+	// Result of the last chessboard detection, including the time spent
+	// at each pyramid level (see config.pyramid_factor).
+	const ofxReprojectionChessboardResult& getDetectionResult() { return detection; }
+
 	ofxReprojectionCalibrationConfig config;
 
 private:
@@ -106,9 +133,8 @@ private:
 	void updateChessboard();
 	void updatePoints3DView();
 	void update(bool forceupdate);
+	void updateStabilityBuffer();
 
-	static const cv::Mat lm_affinerow;
-	static void lm_evaluate_camera_matrix(const double *par, int m_dat, const void *data, double *fvec, int *info);
 
 	void mousePressedChessboard(ofMouseEventArgs &mouse);
 	void mouseDraggedChessboard(ofMouseEventArgs &mouse);
@@ -117,12 +143,15 @@ private:
 	ofxBase3DVideo* cam;
 	ofxReprojectionCalibrationData *data;
 
-	ofTexture colorImage;
+	ofxReprojectionStreamingTexture colorImage;
 	ofTexture depthImage;
+	ofPixels depthImagePixels;
 	ofFbo statusMessagesImage;
 	ofFbo chessboardImage;
 
-	ofFloatImage depthFloats;
+	ofxReprojectionStreamingTexture depthTexture;
+	ofxReprojectionRawDepthSource *rawDepthSource;
+	float depthScale;
 
 	void keyPressed(ofKeyEventArgs& e);
 
@@ -130,7 +159,6 @@ private:
 	bool bChessboardMouseControlEnabled;
 	bool bUse3DView;
 
-	int stability_buffer_i;
 	int camWidth, camHeight;
 
 	vector<ofRectangle> lastChessboards;
@@ -141,9 +169,9 @@ private:
 	ofPoint draggingStartPoint;
 	int draggingButton;
 
-	bool chessfound;
-	bool chessfound_includes_depth;
-	bool chessfound_planar;
+	ofxReprojectionChessboardDetector detector;
+	ofxReprojectionChessboardResult detection;
+
 	bool chessfound_enough_frames;
 	bool chessfound_variance_ok;
 
@@ -151,25 +179,26 @@ private:
 	ofRectangle chessboardArea;
 	int chessboardBrightness;
 
-	vector< vector<cv::Point3f> > corner_history;
+	ofxReprojectionStabilityBuffer corner_history;
 
 	bool measurement_pause;
 	unsigned long measurement_pause_time;
 
-	double plane_r2;
 	uint num_ok_frames;
 	float largest_variance_xy;
 	float largest_variance_z;
 
 	int refMaxDepth;
+	unsigned int framesSinceDepthRange;
+	ofxReprojectionDepthStatistics depthStatistics;
 
 	bool bFinalized;
 
 	ofxEasyCamArea cam3DView;
 	ofFbo fbo3DView;
-	ofVboMesh grid3DView;
+	ofxReprojectionGrid grid3DView;
 	ofVboMesh points3DView;
-	ofShader shader3DView;
+	ofPtr<ofxReprojectionShader> shader3DView;
 
 	bool bHasReceivedFirstFrame;
 
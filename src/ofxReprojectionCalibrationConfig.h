@@ -9,6 +9,16 @@ struct ofxReprojectionCalibrationConfig {
 	float variance_threshold_xy;
 	float variance_threshold_z;
 	unsigned int measurement_pause_length;
+	bool use_threaded_detection;
+	unsigned int pyramid_factor;
+	bool use_roi_tracking;
+	float roi_margin;
+	unsigned int roi_max_misses;
+	bool auto_depth_range;
+	unsigned int auto_depth_range_interval;
+	float auto_depth_range_percentile;
+	bool use_procedural_grid;
+	bool use_raw_depth;
 
 	ofxReprojectionCalibrationConfig():
 			 num_stability_frames(20),
@@ -18,6 +28,16 @@ struct ofxReprojectionCalibrationConfig {
 			 planar_threshold(0.98),
 			 variance_threshold_xy(0.3),
 			 variance_threshold_z(0.01),
-			 measurement_pause_length(3000)
+			 measurement_pause_length(3000),
+			 use_threaded_detection(false),
+			 pyramid_factor(1),
+			 use_roi_tracking(false),
+			 roi_margin(0.25),
+			 roi_max_misses(5),
+			 auto_depth_range(false),
+			 auto_depth_range_interval(30),
+			 auto_depth_range_percentile(99),
+			 use_procedural_grid(false),
+			 use_raw_depth(true)
 		{}
 };
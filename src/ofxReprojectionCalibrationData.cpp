@@ -2,9 +2,11 @@
 #include "ofxReprojectionCalibration.h"
 
 ofxReprojectionCalibrationData::ofxReprojectionCalibrationData() {
+	bUseLMRefinement = false;
 }
 
 ofxReprojectionCalibrationData::ofxReprojectionCalibrationData(string filename) {
+	bUseLMRefinement = false;
 	loadFile(filename);
 }
 
@@ -14,22 +16,60 @@ ofxReprojectionCalibrationData::~ofxReprojectionCalibrationData() {
 
 void ofxReprojectionCalibrationData::updateMatrix() {
 	if(camPoints.size() > 0) {
-		projmat = ofxReprojectionCalibration::calculateReprojectionTransform(*this);
+		projmat = ofxReprojectionCalibration::calculateReprojectionTransform(*this, bUseLMRefinement);
 	} else {
 		projmat = ofMatrix4x4::newIdentityMatrix();
 
 	}
 }
 
+ofxReprojectionNormalEquations ofxReprojectionCalibrationData::getNormalEquations() {
+	if(normalEquations.size() != camPoints.size()) {
+		ofLogWarning("ofxReprojection") << "getNormalEquations(): measurements changed outside "
+			"ofxReprojectionCalibrationData, recalculating.";
+		updateNormalEquations();
+	}
+
+	if(normalEquations.empty()) {
+		return ofxReprojectionNormalEquations();
+	}
+	return normalEquations.back();
+}
+
+void ofxReprojectionCalibrationData::updateNormalEquations() {
+	normalEquations.clear();
+	normalEquations.reserve(camPoints.size());
+
+	for(uint i = 0; i < camPoints.size(); i++) {
+		ofxReprojectionNormalEquations sums;
+		if(i > 0) {
+			sums = normalEquations.back();
+		}
+		if(i < projectorPoints.size()) {
+			sums.add(camPoints[i], projectorPoints[i]);
+		}
+		normalEquations.push_back(sums);
+	}
+}
+
 void ofxReprojectionCalibrationData::addMeasurement(vector<ofVec3f> newCamPoints, vector<ofVec2f> newProjectorPoints) {
 	camPoints.push_back(newCamPoints);
 	projectorPoints.push_back(newProjectorPoints);
+
+	ofxReprojectionNormalEquations sums;
+	if(!normalEquations.empty()) {
+		sums = normalEquations.back();
+	}
+	sums.add(newCamPoints, newProjectorPoints);
+	normalEquations.push_back(sums);
+
 	updateMatrix();
 }
 
 void ofxReprojectionCalibrationData::clear() {
 	camPoints.clear();
 	projectorPoints.clear();
+	normalEquations.clear();
 	updateMatrix();
 }
 
@@ -38,6 +78,9 @@ void ofxReprojectionCalibrationData::deleteLastMeasurement() {
 		camPoints.pop_back();
 		projectorPoints.pop_back();
 	}
+	if(normalEquations.size() > 0) {
+		normalEquations.pop_back();
+	}
 	updateMatrix();
 }
 
@@ -113,6 +156,7 @@ void ofxReprojectionCalibrationData::loadFile(string filename) {
 	xml.setToParent();
 
 
+	updateNormalEquations();
 	updateMatrix();
 }
 
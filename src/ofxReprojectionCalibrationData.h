@@ -2,6 +2,8 @@
 
 #include "ofMain.h"
 
+#include "ofxReprojectionLeastSquares.h"
+
 class ofxReprojectionCalibrationData {
 	public:
 		ofxReprojectionCalibrationData();
@@ -17,10 +19,20 @@ class ofxReprojectionCalibrationData {
 
 		void updateMatrix();
 
+		// Refine the directly solved matrix by Levenberg-Marquardt (off by default).
+		void setUseLMRefinement(bool b) { bUseLMRefinement = b; updateMatrix(); }
+		bool getUseLMRefinement() { return bUseLMRefinement; }
+
 		ofMatrix4x4 getMatrix() { return projmat; }
 		vector< vector< ofVec3f > >& getCamPoints() { return camPoints; }
 		vector< vector< ofVec2f > >& getProjectorPoints() { return projectorPoints; }
 
+		// Least squares sums over all measurements, kept up to date by addMeasurement(),
+		// deleteLastMeasurement(), clear() and loadFile(). Call updateNormalEquations()
+		// after changing the points through getCamPoints() or getProjectorPoints().
+		ofxReprojectionNormalEquations getNormalEquations();
+		void updateNormalEquations();
+
 		void addMeasurement(vector<ofVec3f> newCamPoints, vector<ofVec2f> newProjectorPoints);
 		void clear();
 		void deleteLastMeasurement();
@@ -29,4 +41,9 @@ class ofxReprojectionCalibrationData {
 		vector< vector< ofVec3f > > camPoints;
 		vector< vector< ofVec2f > > projectorPoints;
 		ofMatrix4x4 projmat;
+		bool bUseLMRefinement;
+
+		// normalEquations[i] holds the sums over measurements 0..i, so the
+		// last measurement is removed exactly by dropping the last element.
+		vector<ofxReprojectionNormalEquations> normalEquations;
 };
@@ -0,0 +1,189 @@
+#include "ofxReprojectionCaptureThread.h"
+
+ofxReprojectionCaptureFrame::ofxReprojectionCaptureFrame() {
+	timestamp = 0;
+	colorTimestamp = 0;
+	depthTimestamp = 0;
+	sequence = 0;
+}
+
+ofxReprojectionCaptureThread::ofxReprojectionCaptureThread() {
+	cam = NULL;
+	timestampSource = NULL;
+	bSynchronization = true;
+	syncHistorySize = 4;
+	syncTolerance = 17000;
+	lastColorTimestamp = 0;
+	lastDepthTimestamp = 0;
+	sequence = 0;
+	frontIndex = 0;
+	readyIndex = 1;
+	backIndex = 2;
+	bReadyFrame = false;
+	bFrameNew = false;
+	numDroppedFrames = 0;
+	bDepthTextureDirty = false;
+}
+
+ofxReprojectionCaptureThread::~ofxReprojectionCaptureThread() {
+	stop();
+}
+
+bool ofxReprojectionCaptureThread::setup(ofxBase3DVideo *cam) {
+	if(cam == NULL) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionCaptureThread::setup needs a valid ofxBase3DVideo.";
+		return false;
+	}
+
+	stop();
+	this->cam = cam;
+	sequence = 0;
+
+	timestampSource = bSynchronization ? dynamic_cast<ofxReprojectionTimestampSource*>(cam) : NULL;
+	if(timestampSource != NULL) {
+		ofLogVerbose("ofxReprojection") << "Capture thread pairing color and depth by timestamp.";
+		synchronizer.setup(syncHistorySize, syncTolerance);
+		synchronizer.resetStatistics();
+		lastColorTimestamp = timestampSource->getColorTimestamp();
+		lastDepthTimestamp = timestampSource->getDepthTimestamp();
+	}
+
+	lock();
+	bReadyFrame = false;
+	numDroppedFrames = 0;
+	syncStatistics = ofxReprojectionSyncStatistics();
+	unlock();
+
+	ofLogVerbose("ofxReprojection") << "Starting capture thread.";
+	startThread(true, false);
+
+	return true;
+}
+
+void ofxReprojectionCaptureThread::setSynchronizationEnabled(bool b, unsigned int historySize,
+		unsigned long long tolerance) {
+	bSynchronization = b;
+	syncHistorySize = historySize;
+	syncTolerance = tolerance;
+}
+
+ofxReprojectionSyncStatistics ofxReprojectionCaptureThread::getSyncStatistics() {
+	lock();
+	ofxReprojectionSyncStatistics s = syncStatistics;
+	unlock();
+	return s;
+}
+
+void ofxReprojectionCaptureThread::stop() {
+	if(isThreadRunning()) {
+		ofLogVerbose("ofxReprojection") << "Stopping capture thread.";
+		waitForThread(true);
+	}
+}
+
+void ofxReprojectionCaptureThread::close() {
+	stop();
+	if(cam != NULL) {
+		cam->close();
+	}
+}
+
+void ofxReprojectionCaptureThread::update() {
+	lock();
+	bFrameNew = bReadyFrame;
+	if(bReadyFrame) {
+		std::swap(frontIndex, readyIndex);
+		bReadyFrame = false;
+	}
+	unlock();
+
+	if(bFrameNew) {
+		bDepthTextureDirty = true;
+	}
+}
+
+ofTexture& ofxReprojectionCaptureThread::getDepthTextureReference() {
+	if(bDepthTextureDirty) {
+		ofFloatPixels &distance = frames[frontIndex].distance;
+		if(!depthTexture.isAllocated() || depthTexture.getWidth() != distance.getWidth()
+				|| depthTexture.getHeight() != distance.getHeight()) {
+			depthTexture.allocate(distance.getWidth(), distance.getHeight(), GL_LUMINANCE32F_ARB);
+		}
+		depthTexture.loadData(distance.getPixels(), distance.getWidth(), distance.getHeight(), GL_LUMINANCE);
+		bDepthTextureDirty = false;
+	}
+	return depthTexture;
+}
+
+unsigned long ofxReprojectionCaptureThread::getNumDroppedFrames() {
+	lock();
+	unsigned long n = numDroppedFrames;
+	unlock();
+	return n;
+}
+
+void ofxReprojectionCaptureThread::threadedFunction() {
+	while(isThreadRunning()) {
+		cam->update();
+
+		bool bCaptured = (timestampSource != NULL ? captureSynchronizedFrame() : captureFrame());
+		if(!bCaptured) {
+			ofSleepMillis(1);
+			continue;
+		}
+
+		frames[backIndex].timestamp = ofGetElapsedTimeMicros();
+		frames[backIndex].sequence = ++sequence;
+
+		lock();
+		if(bReadyFrame) {
+			numDroppedFrames++;
+		}
+		std::swap(backIndex, readyIndex);
+		bReadyFrame = true;
+		if(timestampSource != NULL) {
+			syncStatistics = synchronizer.getStatistics();
+		}
+		unlock();
+	}
+}
+
+bool ofxReprojectionCaptureThread::captureFrame() {
+	if(!cam->isFrameNew()) {
+		return false;
+	}
+
+	// The back slot belongs to this thread, it is filled without the lock.
+	ofxReprojectionCaptureFrame &frame = frames[backIndex];
+
+	ofPixels &color = cam->getPixelsRef();
+	int width = color.getWidth();
+	int height = color.getHeight();
+	frame.color = color;
+	frame.depthImage.setFromPixels(cam->getDepthPixels(), width, height, 1);
+	frame.distance.setFromPixels(cam->getDistancePixels(), width, height, 1);
+	frame.colorTimestamp = 0;
+	frame.depthTimestamp = 0;
+
+	return true;
+}
+
+bool ofxReprojectionCaptureThread::captureSynchronizedFrame() {
+	unsigned long long colorTimestamp = timestampSource->getColorTimestamp();
+	unsigned long long depthTimestamp = timestampSource->getDepthTimestamp();
+
+	ofPixels &color = cam->getPixelsRef();
+	if(colorTimestamp != lastColorTimestamp) {
+		synchronizer.addColorFrame(color, colorTimestamp);
+		lastColorTimestamp = colorTimestamp;
+	}
+	if(depthTimestamp != lastDepthTimestamp) {
+		synchronizer.addDepthFrame(cam->getDistancePixels(), cam->getDepthPixels(),
+				color.getWidth(), color.getHeight(), depthTimestamp);
+		lastDepthTimestamp = depthTimestamp;
+	}
+
+	ofxReprojectionCaptureFrame &frame = frames[backIndex];
+	return synchronizer.getPair(frame.color, frame.depthImage, frame.distance,
+			frame.colorTimestamp, frame.depthTimestamp);
+}
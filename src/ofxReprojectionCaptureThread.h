@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxBase3DVideo.h"
+#include "ofxReprojectionFrameSynchronizer.h"
+#include "ofxReprojectionTimestampSource.h"
+
+// A frame from the camera: color, depth and the time it was captured. The
+// color and depth are from the same update of the camera, or paired by
+// their timestamps.
+struct ofxReprojectionCaptureFrame {
+	ofxReprojectionCaptureFrame();
+
+	ofPixels color;
+	ofPixels depthImage;
+	ofFloatPixels distance;
+
+	// ofGetElapsedTimeMicros() when the capture thread got the frame.
+	unsigned long long timestamp;
+
+	// Capture times of the color and depth images from the camera clock,
+	// if the camera implements ofxReprojectionTimestampSource, otherwise 0.
+	unsigned long long colorTimestamp;
+	unsigned long long depthTimestamp;
+
+	// Number of the frame from the camera, counting from 1. Gaps are frames
+	// that were replaced before update() picked them up.
+	unsigned long sequence;
+};
+
+// Runs another ofxBase3DVideo on its own thread, and is an ofxBase3DVideo
+// itself, so it can be passed to ofxReprojectionCalibration and
+// ofxReprojectionRenderer2D instead of the camera.
+//
+// The capture thread calls update() of the camera in a loop, and copies each
+// new frame into a free slot of a triple buffer. update() on the calling
+// thread takes the latest complete frame, if there is one, and all getters
+// return that frame until the next update(). So color and depth are always a
+// matching pair, and the frame does not change while it is being used. The
+// two threads only share the slot indices, which are swapped under a lock
+// held for a few instructions, and neither waits for the other to copy or
+// use a frame. Frames the capture thread replaces before they are picked up
+// are counted in getNumDroppedFrames().
+//
+// If the camera implements ofxReprojectionTimestampSource, its color and
+// depth images are collected separately as they change, and paired by
+// nearest timestamp (see ofxReprojectionFrameSynchronizer). Otherwise the
+// frame is whatever both images hold after an update of the camera.
+//
+// The camera must not make GL calls in update(), since it runs outside the
+// GL thread (e.g. disable its textures). The depth texture of this object is
+// uploaded on the calling thread instead, when it is asked for.
+//
+
+class ofxReprojectionCaptureThread : public ofxBase3DVideo, public ofThread {
+	public:
+		ofxReprojectionCaptureThread();
+		~ofxReprojectionCaptureThread();
+
+		// Start capturing from cam, which is used only by the capture thread
+		// until stop() or close().
+		bool setup(ofxBase3DVideo *cam);
+		void stop();
+
+		// Pair color and depth by timestamp, when the camera provides them
+		// (default). historySize and tolerance (microseconds) are passed to
+		// ofxReprojectionFrameSynchronizer::setup. Read in setup().
+		void setSynchronizationEnabled(bool b, unsigned int historySize = 4, unsigned long long tolerance = 17000);
+		bool getSynchronizationEnabled() { return bSynchronization; }
+		bool isSynchronizing() { return timestampSource != NULL; }
+		ofxReprojectionSyncStatistics getSyncStatistics();
+
+		// Take the latest frame from the capture thread.
+		void update();
+		bool isFrameNew() { return bFrameNew; }
+
+		// The frame returned by the getters until the next update().
+		const ofxReprojectionCaptureFrame& getFrame() { return frames[frontIndex]; }
+
+		// Size of the color image, 0 before the first frame.
+		int getWidth() { return getFrame().color.getWidth(); }
+		int getHeight() { return getFrame().color.getHeight(); }
+
+		unsigned char* getPixels() { return frames[frontIndex].color.getPixels(); }
+		ofPixels& getPixelsRef() { return frames[frontIndex].color; }
+		unsigned char* getDepthPixels() { return frames[frontIndex].depthImage.getPixels(); }
+		float* getDistancePixels() { return frames[frontIndex].distance.getPixels(); }
+		ofTexture& getDepthTextureReference();
+
+		// Stops the capture thread and closes the camera.
+		void close();
+
+		unsigned long getNumDroppedFrames();
+
+	private:
+		void threadedFunction();
+
+		ofxBase3DVideo *cam;
+		ofxReprojectionTimestampSource *timestampSource;
+
+		bool bSynchronization;
+		unsigned int syncHistorySize;
+		unsigned long long syncTolerance;
+		ofxReprojectionFrameSynchronizer synchronizer;
+
+		// Copy of the synchronizer statistics for the calling thread, updated
+		// under the thread mutex.
+		ofxReprojectionSyncStatistics syncStatistics;
+
+		// Fill frames[backIndex] from the camera, false if there is no new
+		// frame (or pair) yet.
+		bool captureFrame();
+		bool captureSynchronizedFrame();
+		unsigned long long lastColorTimestamp;
+		unsigned long long lastDepthTimestamp;
+		unsigned long sequence;
+
+		// Triple buffer. The capture thread writes frames[backIndex], the
+		// calling thread reads frames[frontIndex], and frames[readyIndex]
+		// holds the latest complete frame, new if bReadyFrame is set. The
+		// indices are swapped under the thread mutex.
+		ofxReprojectionCaptureFrame frames[3];
+		int frontIndex;
+		int readyIndex;
+		int backIndex;
+		bool bReadyFrame;
+
+		bool bFrameNew;
+		unsigned long numDroppedFrames;
+
+		ofTexture depthTexture;
+		bool bDepthTextureDirty;
+};
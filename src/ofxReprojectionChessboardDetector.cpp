@@ -0,0 +1,372 @@
+#include "ofxReprojectionChessboardDetector.h"
+
+void ofxReprojectionChessboardResult::swap(ofxReprojectionChessboardResult &other) {
+	std::swap(chessfound, other.chessfound);
+	std::swap(includes_depth, other.includes_depth);
+	std::swap(planar, other.planar);
+	std::swap(plane_r2, other.plane_r2);
+	std::swap(pyramid_factor, other.pyramid_factor);
+	std::swap(time_downscale, other.time_downscale);
+	std::swap(time_search, other.time_search);
+	std::swap(time_refine, other.time_refine);
+	corners.swap(other.corners);
+	corners_depth.swap(other.corners_depth);
+}
+
+void ofxReprojectionChessboardDetector::Frame::swap(Frame &other) {
+	color.swap(other.color);
+	depth.swap(other.depth);
+	std::swap(boardSize, other.boardSize);
+	std::swap(config, other.config);
+}
+
+ofxReprojectionChessboardDetector::ofxReprojectionChessboardDetector() {
+	bFramePending = false;
+	bResultPending = false;
+	numDroppedFrames = 0;
+
+	trackingMisses = 0;
+}
+
+ofxReprojectionChessboardDetector::~ofxReprojectionChessboardDetector() {
+	stopWorker();
+}
+
+void ofxReprojectionChessboardDetector::startWorker() {
+	if(isThreadRunning()) return;
+
+	lock();
+	bFramePending = false;
+	bResultPending = false;
+	unlock();
+
+	ofLogVerbose("ofxReprojection") << "Starting chessboard detection worker thread.";
+	startThread(true, false);
+}
+
+void ofxReprojectionChessboardDetector::stopWorker() {
+	if(!isThreadRunning()) return;
+
+	ofLogVerbose("ofxReprojection") << "Stopping chessboard detection worker thread.";
+	waitForThread(true);
+}
+
+void ofxReprojectionChessboardDetector::submitFrame(unsigned char *colorPixels, float *depthPixels,
+		int width, int height, cv::Size boardSize, const ofxReprojectionCalibrationConfig &config) {
+
+	// Copy outside the lock, so that the worker is never kept waiting by the copy.
+	stagingFrame.color.setFromPixels(colorPixels, width, height, 3);
+	stagingFrame.depth.setFromPixels(depthPixels, width, height, 1);
+	stagingFrame.boardSize = boardSize;
+	stagingFrame.config = config;
+
+	lock();
+	if(bFramePending) {
+		numDroppedFrames++;
+	}
+	pendingFrame.swap(stagingFrame);
+	bFramePending = true;
+	unlock();
+}
+
+bool ofxReprojectionChessboardDetector::getResult(ofxReprojectionChessboardResult &result) {
+	bool bGotResult = false;
+
+	lock();
+	if(bResultPending) {
+		result.swap(publishedResult);
+		bResultPending = false;
+		bGotResult = true;
+	}
+	unlock();
+
+	return bGotResult;
+}
+
+unsigned long ofxReprojectionChessboardDetector::getNumDroppedFrames() {
+	lock();
+	unsigned long n = numDroppedFrames;
+	unlock();
+	return n;
+}
+
+void ofxReprojectionChessboardDetector::threadedFunction() {
+	while(isThreadRunning()) {
+		bool bGotFrame = false;
+
+		lock();
+		if(bFramePending) {
+			workerFrame.swap(pendingFrame);
+			bFramePending = false;
+			bGotFrame = true;
+		}
+		unlock();
+
+		if(!bGotFrame) {
+			ofSleepMillis(1);
+			continue;
+		}
+
+		track(workerFrame.color.getPixels(), workerFrame.depth.getPixels(),
+				workerFrame.color.getWidth(), workerFrame.color.getHeight(),
+				workerFrame.boardSize, workerFrame.config, workerResult);
+
+		lock();
+		publishedResult.swap(workerResult);
+		bResultPending = true;
+		unlock();
+	}
+}
+
+void ofxReprojectionChessboardDetector::track(unsigned char *colorPixels, float *depthPixels,
+		int width, int height, cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+		ofxReprojectionChessboardResult &result) {
+
+	cv::Rect fullImage(0, 0, width, height);
+
+	if(!config.use_roi_tracking || trackingArea.area() == 0) {
+		detect(colorPixels, depthPixels, width, height, boardSize, config, fullImage, result);
+	} else {
+		detect(colorPixels, depthPixels, width, height, boardSize, config, trackingArea & fullImage, result);
+	}
+
+	if(!config.use_roi_tracking) {
+		trackingArea = cv::Rect();
+		trackingMisses = 0;
+		return;
+	}
+
+	if(result.chessfound) {
+		// Predict that the chessboard in the next frame will be close to
+		// the current one, with a margin relative to the chessboard size.
+		float minx = result.corners[0].x, maxx = minx;
+		float miny = result.corners[0].y, maxy = miny;
+		for(uint i = 1; i < result.corners.size(); i++) {
+			minx = MIN(minx, result.corners[i].x);
+			maxx = MAX(maxx, result.corners[i].x);
+			miny = MIN(miny, result.corners[i].y);
+			maxy = MAX(maxy, result.corners[i].y);
+		}
+
+		// The outer corners found are one square inside the chessboard,
+		// so add one square on each side, plus the margin.
+		float squarex = (maxx - minx) / MAX(boardSize.width - 1, 1);
+		float squarey = (maxy - miny) / MAX(boardSize.height - 1, 1);
+		float marginx = squarex + config.roi_margin*(maxx - minx + 2*squarex);
+		float marginy = squarey + config.roi_margin*(maxy - miny + 2*squarey);
+
+		int x1 = MAX((int)(minx - marginx), 0);
+		int y1 = MAX((int)(miny - marginy), 0);
+		int x2 = MIN((int)(maxx + marginx) + 1, width);
+		int y2 = MIN((int)(maxy + marginy) + 1, height);
+
+		trackingArea = cv::Rect(x1, y1, x2 - x1, y2 - y1);
+		trackingMisses = 0;
+	} else if(trackingArea.area() > 0) {
+		trackingMisses++;
+		if(trackingMisses >= config.roi_max_misses) {
+			trackingArea = cv::Rect();
+			trackingMisses = 0;
+		}
+	}
+}
+
+void ofxReprojectionChessboardDetector::detect(unsigned char *colorPixels, float *depthPixels,
+		int width, int height, cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+		ofxReprojectionChessboardResult &result) {
+	detect(colorPixels, depthPixels, width, height, boardSize, config, cv::Rect(0, 0, width, height), result);
+}
+
+void ofxReprojectionChessboardDetector::detect(unsigned char *colorPixels, float *depthPixels,
+		int width, int height, cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+		cv::Rect searchArea, ofxReprojectionChessboardResult &result) {
+
+	result.clear();
+	result.search_area = searchArea;
+
+	cv::Mat chessdetectimage(height, width, CV_8UC(3), colorPixels);
+
+	cv::Mat gray;
+	cv::cvtColor(chessdetectimage, gray, CV_BGR2GRAY);
+
+	cv::Mat region = gray(searchArea);
+
+	// Search for the chessboard on a downscaled pyramid level, where most of the
+	// time is spent on frames without a chessboard, and refine the corners
+	// found on the full resolution image.
+	unsigned int factor = config.pyramid_factor > 1 ? config.pyramid_factor : 1;
+	if(region.cols / (int)factor < boardSize.width || region.rows / (int)factor < boardSize.height) {
+		factor = 1;
+	}
+	result.pyramid_factor = factor;
+
+	unsigned long long time_start = ofGetElapsedTimeMicros();
+
+	cv::Mat search;
+	if(factor > 1) {
+		cv::resize(region, search, cv::Size(region.cols/factor, region.rows/factor), 0, 0, cv::INTER_AREA);
+	} else {
+		search = region;
+	}
+
+	unsigned long long time_downscaled = ofGetElapsedTimeMicros();
+	result.time_downscale = time_downscaled - time_start;
+
+	result.chessfound = cv::findChessboardCorners(search, boardSize, result.corners,
+			cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_FAST_CHECK);
+
+	unsigned long long time_searched = ofGetElapsedTimeMicros();
+	result.time_search = time_searched - time_downscaled;
+
+	if(!result.chessfound) {
+		return;
+	}
+
+	int subpix_window = 5;
+	if(factor > 1) {
+		// Pixel centers of the pyramid level map to the centers of
+		// factor x factor blocks in the full resolution image.
+		float scale_x = (float)region.cols / search.cols;
+		float scale_y = (float)region.rows / search.rows;
+		for(uint i = 0; i < result.corners.size(); i++) {
+			result.corners[i].x = (result.corners[i].x + 0.5f)*scale_x - 0.5f;
+			result.corners[i].y = (result.corners[i].y + 0.5f)*scale_y - 0.5f;
+		}
+
+		// The scaled-up corners can be off by about one pyramid level pixel.
+		subpix_window = MAX(subpix_window, 2*(int)factor);
+	}
+
+	for(uint i = 0; i < result.corners.size(); i++) {
+		result.corners[i].x += searchArea.x;
+		result.corners[i].y += searchArea.y;
+	}
+
+	cv::cornerSubPix(gray, result.corners, cv::Size(subpix_window, subpix_window), cv::Size(-1, -1),
+		cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
+
+	result.time_refine = ofGetElapsedTimeMicros() - time_searched;
+
+	// Add depth data to corners found (interpolate integer z coord to match fractional x,y coords)
+
+	// Calculate matrix elements for solving planar regression (multiple linear regression)
+	// to find R^2-value of plane (how planar is the chess board?).
+	//
+	// This test is not strictly needed, but in case you are using a flat board to
+	// move around for the chessboard to be projected on, then this will be a test
+	// that can give an indication of whether the measurements are good.
+	// Can be disabled in config.use_planar_condition.
+
+	double sumX = 0;
+	double sumY = 0;
+	double sumZ = 0;
+	double sumX2 = 0;
+	double sumY2 = 0;
+	double sumXY = 0;
+	double sumYZ = 0;
+	double sumXZ = 0;
+	double n = 0;
+
+	float *pDPixel = depthPixels;
+
+	result.includes_depth = true;
+	for(uint i = 0; i < result.corners.size(); i++) {
+		// Calculate 3D point from color and depth image ("world coords")
+		cv::Point3f p;
+		p.x = result.corners[i].x;
+		p.y = result.corners[i].y;
+
+		int imgx1 = ((int) p.x);
+		int imgx2 = ((int) p.x) +1;
+
+		int imgy1 = ((int) p.y);
+		int imgy2 = ((int) p.y) +1;
+
+		// Corners on the image border have no neighbours to interpolate from.
+		if(imgx1 < 0 || imgy1 < 0 || imgx2 >= width || imgy2 >= height) {
+			result.includes_depth = false;
+			break;
+		}
+
+		// Check that all relevant depth values are valid;
+		int depth_values_test[4] = {
+			imgx1+imgy1*width,
+			imgx1+imgy2*width,
+			imgx2+imgy1*width,
+			imgx2+imgy2*width };
+
+		for(uint j = 0; j < 4; j++) {
+			int value = (int)pDPixel[depth_values_test[j]];
+			if(value < config.depth_min || value > config.depth_max) {
+				result.includes_depth = false;
+				break;
+			}
+		}
+
+		float interp_x1, interp_x2, interp_z;
+
+		// Bilinear interpolation to find z in depth map from fractional coords.
+		// (The detected corners have sub-pixel precision.)
+		interp_x1  = (imgx2-(float)p.x)/((float)(imgx2-imgx1))*((float)pDPixel[imgx1+imgy1*width]);
+		interp_x1 += ((float)p.x-imgx1)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy1*width]);
+
+		interp_x2  = (imgx2-(float)p.x)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy1*width]);
+		interp_x2 += ((float)p.x-imgx1)/((float)(imgx2-imgx1))*((float)pDPixel[imgx2+imgy2*width]);
+
+		interp_z   = (imgy2-(float)p.y)/((float)(imgy2-imgy1)) * interp_x1;
+		interp_z  += ((float)p.y-imgy1)/((float)(imgy2-imgy1)) * interp_x2;
+
+		p.z = interp_z;
+
+		// Sum values for planar regression below
+		sumX += p.x;
+		sumY += p.y;
+		sumZ += p.z;
+		sumX2 += p.x*p.x;
+		sumY2 += p.y*p.y;
+		sumXY += p.x*p.y;
+		sumYZ += p.y*p.z;
+		sumXZ += p.x*p.z;
+		n += 1;
+
+		result.corners_depth.push_back(p);
+	}
+
+	if(!result.includes_depth) {
+		return;
+	}
+
+	// Solve least squares to find plane equation
+	cv::Mat lsq_left = ( cv::Mat_<double>(3,3)  << sumX2, sumXY, sumX, sumXY, sumY2, sumY, sumX, sumY, n );
+	cv::Mat lsq_right = ( cv::Mat_<double>(3,1) << sumXZ, sumYZ, sumZ );
+
+	cv::Mat_<double> plane;
+
+	bool planesolved = cv::solve(lsq_left, lsq_right, plane);
+
+	if(planesolved) {
+
+		// Find R^2 of regression to assess planarity
+
+		double ssres = 0;
+		double sstot = 0;
+		for(uint i = 0; i < result.corners_depth.size(); i++) {
+			double tot = result.corners_depth[i].z-sumZ/n;
+			sstot += tot*tot;
+
+			double fz = plane(0,0)*result.corners_depth[i].x
+				  + plane(0,1)*result.corners_depth[i].y
+				  + plane(0,2);
+			double res = result.corners_depth[i].z - fz;
+			ssres += res*res;
+		}
+
+		result.plane_r2 = 1 - ssres/sstot;
+
+		if(config.use_planar_condition) {
+			result.planar = result.plane_r2 > config.planar_threshold;
+		} else {
+			result.planar = true;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ofMain.h"
+
+#include "ofxReprojectionCalibrationConfig.h"
+
+// Result of a chessboard detection on one color/depth frame pair.
+//
+// corners contains the sub-pixel chessboard corners in color image coordinates,
+// corners_depth contains the same corners with the z coordinate interpolated
+// from the depth image.
+//
+// search_area is the part of the color image that was searched for the chessboard.
+// The timings (in microseconds) are for downscaling the search area to the pyramid
+// level given by config.pyramid_factor, searching for the chessboard at that
+// level, and refining the corners at full resolution.
+struct ofxReprojectionChessboardResult {
+	bool chessfound;
+	bool includes_depth;
+	bool planar;
+	double plane_r2;
+
+	cv::Rect search_area;
+	unsigned int pyramid_factor;
+	unsigned long long time_downscale;
+	unsigned long long time_search;
+	unsigned long long time_refine;
+
+	vector<cv::Point2f> corners;
+	vector<cv::Point3f> corners_depth;
+
+	ofxReprojectionChessboardResult() { clear(); }
+
+	void clear() {
+		chessfound = false;
+		includes_depth = false;
+		planar = false;
+		plane_r2 = 0;
+		search_area = cv::Rect();
+		pyramid_factor = 1;
+		time_downscale = 0;
+		time_search = 0;
+		time_refine = 0;
+		corners.clear();
+		corners_depth.clear();
+	}
+
+	void swap(ofxReprojectionChessboardResult &other);
+};
+
+// This class finds the chessboard corners in a color image and samples the
+// depth image at the corner positions.
+//
+// detect() runs the detection on the whole image on the calling thread. track()
+// does the same, but if config.use_roi_tracking is set, it only searches a region
+// around the corners found in the previous frame. After config.roi_max_misses
+// frames without a chessboard in the region, the whole image is searched again.
+//
+// Alternatively, startWorker()
+// starts a worker thread and frames given to submitFrame() are processed in the
+// background. Only the latest submitted frame is kept: if a new frame is submitted
+// before the worker has picked up the previous one, the previous one is dropped
+// and counted in getNumDroppedFrames(). Finished results are fetched with
+// getResult(), which never waits for the worker.
+//
+
+class ofxReprojectionChessboardDetector : public ofThread {
+public:
+	ofxReprojectionChessboardDetector();
+	~ofxReprojectionChessboardDetector();
+
+	static void detect(unsigned char *colorPixels, float *depthPixels, int width, int height,
+			cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+			ofxReprojectionChessboardResult &result);
+
+	void track(unsigned char *colorPixels, float *depthPixels, int width, int height,
+			cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+			ofxReprojectionChessboardResult &result);
+
+	void startWorker();
+	void stopWorker();
+	bool isWorkerRunning() { return isThreadRunning(); }
+
+	void submitFrame(unsigned char *colorPixels, float *depthPixels, int width, int height,
+			cv::Size boardSize, const ofxReprojectionCalibrationConfig &config);
+	bool getResult(ofxReprojectionChessboardResult &result);
+
+	unsigned long getNumDroppedFrames();
+
+private:
+	void threadedFunction();
+
+	static void detect(unsigned char *colorPixels, float *depthPixels, int width, int height,
+			cv::Size boardSize, const ofxReprojectionCalibrationConfig &config,
+			cv::Rect searchArea, ofxReprojectionChessboardResult &result);
+
+	// Region of interest for track(), predicted from the last corners found.
+	cv::Rect trackingArea;
+	unsigned int trackingMisses;
+
+	struct Frame {
+		ofPixels color;
+		ofFloatPixels depth;
+		cv::Size boardSize;
+		ofxReprojectionCalibrationConfig config;
+
+		void swap(Frame &other);
+	};
+
+	// Frame hand-over between the calling thread and the worker. The frame is
+	// copied into stagingFrame without holding the lock, and then swapped into
+	// the single mailbox slot pendingFrame.
+	Frame stagingFrame;
+	Frame pendingFrame;
+	Frame workerFrame;
+	bool bFramePending;
+
+	ofxReprojectionChessboardResult workerResult;
+	ofxReprojectionChessboardResult publishedResult;
+	bool bResultPending;
+
+	unsigned long numDroppedFrames;
+};
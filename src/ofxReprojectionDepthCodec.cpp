@@ -0,0 +1,288 @@
+#include "ofxReprojectionDepthCodec.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//
+// Variable length numbers. Nibble k of the stream is in byte k/2, low
+// nibble first, which is what storing the 64 bit words gives on little
+// endian machines.
+//
+
+namespace {
+
+// Codes of the numbers up to 3 nibbles, for encoding, and the numbers
+// starting with each 3 nibble pattern, for decoding (length 0 if the
+// number is longer).
+struct NumberTables {
+	unsigned short encodeCode[512];
+	unsigned char encodeLength[512];
+
+	// Value in the low 10 bits, number of nibbles from bit 12.
+	unsigned short decode[4096];
+
+	NumberTables() {
+		for(unsigned int v = 0; v < 512; v++) {
+			unsigned int value = v;
+			unsigned int code = 0;
+			unsigned int len = 0;
+			while(value >= 8) {
+				code |= ((value & 7) | 8) << len;
+				len += 4;
+				value >>= 3;
+			}
+			encodeCode[v] = code | (value << len);
+			encodeLength[v] = len + 4;
+		}
+
+		for(unsigned int bits = 0; bits < 4096; bits++) {
+			decode[bits] = 0;
+			unsigned int value = 0;
+			for(unsigned int k = 0; k < 3; k++) {
+				unsigned int nibble = (bits >> 4*k) & 15;
+				value |= (nibble & 7) << 3*k;
+				if(!(nibble & 8)) {
+					decode[bits] = value | (k + 1) << 12;
+					break;
+				}
+			}
+		}
+	}
+};
+
+const NumberTables tables;
+
+struct NibbleWriter {
+	unsigned char *out;
+	unsigned long long buffer;
+	unsigned int bits;
+
+	NibbleWriter(unsigned char *out) : out(out), buffer(0), bits(0) {}
+
+	// Append the low len bits of code, len <= 32.
+	inline void write(unsigned int code, unsigned int len) {
+		buffer |= (unsigned long long)code << bits;
+		bits += len;
+		if(bits >= 64) {
+			memcpy(out, &buffer, sizeof(buffer));
+			out += sizeof(buffer);
+			bits -= 64;
+			buffer = (bits > 0 ? (unsigned long long)code >> (len - bits) : 0);
+		}
+	}
+
+	// Variable length number in 3 bit groups, least significant first,
+	// value < 2^24 so that the code fits in 32 bits.
+	inline void writeNumber(unsigned int value) {
+		if(value < 512) {
+			write(tables.encodeCode[value], tables.encodeLength[value]);
+			return;
+		}
+		unsigned int code = 0;
+		unsigned int len = 0;
+		while(value >= 8) {
+			code |= ((value & 7) | 8) << len;
+			len += 4;
+			value >>= 3;
+		}
+		code |= value << len;
+		write(code, len + 4);
+	}
+
+	void flush() {
+		if(bits > 0) {
+			memcpy(out, &buffer, sizeof(buffer));
+			out += sizeof(buffer);
+			buffer = 0;
+			bits = 0;
+		}
+	}
+};
+
+struct NibbleReader {
+	const unsigned char *in;
+	unsigned int size;
+
+	// Position in nibbles.
+	unsigned long long position;
+
+	NibbleReader(const unsigned char *in, unsigned int size) : in(in), size(size), position(0) {}
+
+	bool isOverrun() { return position > 2ULL*size; }
+
+	// The next 15 nibbles (zeros past the end of the data).
+	inline unsigned long long peek() {
+		unsigned long long byte = position >> 1;
+		unsigned long long bits = 0;
+		if(byte + sizeof(bits) <= size) {
+			memcpy(&bits, in + byte, sizeof(bits));
+		} else if(byte < size) {
+			memcpy(&bits, in + byte, size - byte);
+		}
+		return bits >> 4*(position & 1);
+	}
+
+	inline unsigned int readNumber() {
+		unsigned long long bits = peek();
+		if(!(bits & 8)) {
+			position++;
+			return bits & 7;
+		}
+
+		unsigned int entry = tables.decode[bits & 4095];
+		if(entry >> 10) {
+			position += entry >> 12;
+			return entry & 1023;
+		}
+
+		// Longer numbers, at most 8 nibbles for 24 bits.
+		unsigned int value = 0;
+		unsigned int shift = 0;
+		unsigned int nibble;
+		do {
+			nibble = bits & 15;
+			bits >>= 4;
+			position++;
+			value |= (nibble & 7) << shift;
+			shift += 3;
+		} while((nibble & 8) && shift < 24);
+		return value;
+	}
+};
+
+// Index of the first pixel in [i, n) that is zero (or non-zero), n if none.
+inline int findZero(const unsigned short *depth, int i, int n) {
+#ifdef __SSE2__
+	const __m128i vzero = _mm_setzero_si128();
+	for(; i + 8 <= n; i += 8) {
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(depth + i)), vzero));
+		if(mask != 0) {
+			return i + __builtin_ctz(mask)/2;
+		}
+	}
+#endif
+	while(i < n && depth[i] != 0) i++;
+	return i;
+}
+
+inline int findNonZero(const unsigned short *depth, int i, int n) {
+#ifdef __SSE2__
+	const __m128i vzero = _mm_setzero_si128();
+	for(; i + 8 <= n; i += 8) {
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(depth + i)), vzero));
+		if(mask != 0xFFFF) {
+			return i + __builtin_ctz(~mask)/2;
+		}
+	}
+#endif
+	while(i < n && depth[i] == 0) i++;
+	return i;
+}
+
+template<typename T>
+bool decodeDepth(const unsigned char *in, unsigned int size, T *depth, int n) {
+	NibbleReader reader(in, size);
+	int previous = 0;
+	int i = 0;
+
+	while(i < n) {
+		unsigned int zeros = reader.readNumber();
+		unsigned int nonzeros = reader.readNumber();
+		if(reader.isOverrun() || zeros > (unsigned int)(n - i) || nonzeros > (unsigned int)(n - i) - zeros) {
+			return false;
+		}
+
+		std::fill(depth + i, depth + i + zeros, (T)0);
+		i += zeros;
+
+		int end = i + nonzeros;
+
+		// Smooth surfaces give runs of differences of one nibble each,
+		// which are decoded 15 at a time.
+		while(end - i >= 15) {
+			unsigned long long bits = reader.peek();
+			if(bits & 0x0888888888888888ULL) {
+				unsigned int zigzag = reader.readNumber();
+				previous += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+				depth[i++] = (unsigned short)previous;
+				continue;
+			}
+			for(int k = 0; k < 15; k++, bits >>= 4) {
+				unsigned int zigzag = bits & 7;
+				previous += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+				depth[i++] = (unsigned short)previous;
+			}
+			reader.position += 15;
+		}
+
+		for(; i < end; i++) {
+			unsigned int zigzag = reader.readNumber();
+			previous += (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+			depth[i] = (unsigned short)previous;
+		}
+		if(reader.isOverrun()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+const int ofxReprojectionDepthCodec::maxPixels = (1 << 24) - 1;
+
+unsigned int ofxReprojectionDepthCodec::getMaxEncodedSize(int n) {
+	// At most 6 nibbles per pixel (17 bit difference) and 2*8 nibbles per
+	// pair of runs (up to maxPixels), one pair per pixel, plus the last
+	// partial word.
+	return ((unsigned long long)n*(6 + 16)*4 + 63)/64*8 + 8;
+}
+
+unsigned int ofxReprojectionDepthCodec::encode(const unsigned short *depth, int n, unsigned char *out) {
+	if(n > maxPixels) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionDepthCodec::encode: " << n << " pixels is more than "
+			<< maxPixels << ".";
+		return 0;
+	}
+
+	NibbleWriter writer(out);
+	int previous = 0;
+	int i = 0;
+
+	while(i < n) {
+		int valid = findNonZero(depth, i, n);
+		int end = findZero(depth, valid, n);
+		writer.writeNumber(valid - i);
+		writer.writeNumber(end - valid);
+
+		for(i = valid; i < end; i++) {
+			int delta = (int)depth[i] - previous;
+			previous = depth[i];
+			writer.writeNumber(((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+		}
+	}
+
+	writer.flush();
+	return writer.out - out;
+}
+
+bool ofxReprojectionDepthCodec::decode(const unsigned char *in, unsigned int size, unsigned short *depth, int n) {
+	return decodeDepth(in, size, depth, n);
+}
+
+bool ofxReprojectionDepthCodec::decode(const unsigned char *in, unsigned int size, float *depth, int n) {
+	return decodeDepth(in, size, depth, n);
+}
+
+bool ofxReprojectionDepthCodec::convertDepthToShort(const float *in, unsigned short *out, int n) {
+	for(int i = 0; i < n; i++) {
+		float d = in[i];
+		if(!(d >= 0 && d <= 65535) || d != (float)(int)d) {
+			return false;
+		}
+		out[i] = (unsigned short)d;
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Lossless compression of 16 bit depth images, after RVL (Wilson, "Fast
+// Lossless Depth Image Compression", 2017).
+//
+// The pixels are coded in order as alternating runs: the number of zeros
+// (no depth), the number of following valid pixels, and then the valid
+// pixels as differences to the previous valid pixel. Runs and differences
+// (zig-zag mapped to unsigned) are written as variable length numbers of 3
+// bit groups, each group in a nibble with a continuation bit. The nibbles
+// are packed into 64 bit words, least significant first.
+//
+// Depth images are mostly smooth surfaces with holes, so most differences
+// fit in one or two nibbles, and the holes cost a few nibbles each. Each
+// image is coded on its own, so any frame of a recording can be decoded
+// without the others.
+//
+// Runs are at most 8 nibbles (24 bits) long, so an image can have at most
+// maxPixels pixels.
+//
+
+class ofxReprojectionDepthCodec {
+public:
+	static const int maxPixels;
+
+	// Upper bound of the encoded size of n pixels, in bytes.
+	static unsigned int getMaxEncodedSize(int n);
+
+	// Encode n pixels into out, which must hold getMaxEncodedSize(n)
+	// bytes. Returns the encoded size in bytes, or 0 if n is more than
+	// maxPixels.
+	static unsigned int encode(const unsigned short *depth, int n, unsigned char *out);
+
+	// Decode n pixels from size bytes. Returns false if the data is
+	// truncated or does not decode to exactly n pixels.
+	static bool decode(const unsigned char *in, unsigned int size, unsigned short *depth, int n);
+
+	// Decode straight to float depth, as in ofxBase3DVideo::getDistancePixels.
+	static bool decode(const unsigned char *in, unsigned int size, float *depth, int n);
+
+	// Convert float depth to 16 bit if every value is a whole number in
+	// [0, 65535], so that it can be encoded without loss. Returns false
+	// otherwise.
+	static bool convertDepthToShort(const float *in, unsigned short *out, int n);
+};
@@ -0,0 +1,141 @@
+#include "ofxReprojectionFrameSynchronizer.h"
+
+ofxReprojectionSyncStatistics::ofxReprojectionSyncStatistics() {
+	numPairs = 0;
+	numDroppedColorFrames = 0;
+	numDroppedDepthFrames = 0;
+	lastSkew = 0;
+	maxAbsSkew = 0;
+	meanAbsSkew = 0;
+}
+
+ofxReprojectionFrameSynchronizer::ofxReprojectionFrameSynchronizer() {
+	colorStart = 0;
+	colorCount = 0;
+	depthStart = 0;
+	depthCount = 0;
+	tolerance = 17000;
+	setup();
+}
+
+void ofxReprojectionFrameSynchronizer::setup(unsigned int historySize, unsigned long long tolerance) {
+	historySize = MAX(historySize, 1);
+	colorFrames.resize(historySize);
+	depthFrames.resize(historySize);
+	this->tolerance = tolerance;
+	clear();
+}
+
+void ofxReprojectionFrameSynchronizer::clear() {
+	colorStart = 0;
+	colorCount = 0;
+	depthStart = 0;
+	depthCount = 0;
+}
+
+void ofxReprojectionFrameSynchronizer::addColorFrame(const ofPixels &color, unsigned long long timestamp) {
+	unsigned int size = colorFrames.size();
+
+	if(colorCount > 0 && timestamp < colorFrames[(colorStart + colorCount - 1) % size].timestamp) {
+		statistics.numDroppedColorFrames += colorCount;
+		colorStart = 0;
+		colorCount = 0;
+	}
+
+	// When the history is full, the oldest frame is replaced.
+	ColorFrame *frame;
+	if(colorCount < size) {
+		frame = &colorFrames[(colorStart + colorCount) % size];
+		colorCount++;
+	} else {
+		frame = &colorFrames[colorStart];
+		colorStart = (colorStart + 1) % size;
+		statistics.numDroppedColorFrames++;
+	}
+
+	frame->color = color;
+	frame->timestamp = timestamp;
+}
+
+void ofxReprojectionFrameSynchronizer::addDepthFrame(const float *distance, const unsigned char *depthImage,
+		int width, int height, unsigned long long timestamp) {
+	unsigned int size = depthFrames.size();
+
+	if(depthCount > 0 && timestamp < depthFrames[(depthStart + depthCount - 1) % size].timestamp) {
+		statistics.numDroppedDepthFrames += depthCount;
+		depthStart = 0;
+		depthCount = 0;
+	}
+
+	DepthFrame *frame;
+	if(depthCount < size) {
+		frame = &depthFrames[(depthStart + depthCount) % size];
+		depthCount++;
+	} else {
+		frame = &depthFrames[depthStart];
+		depthStart = (depthStart + 1) % size;
+		statistics.numDroppedDepthFrames++;
+	}
+
+	frame->distance.setFromPixels(distance, width, height, 1);
+	if(depthImage != NULL) {
+		frame->depthImage.setFromPixels(depthImage, width, height, 1);
+	}
+	frame->timestamp = timestamp;
+}
+
+bool ofxReprojectionFrameSynchronizer::getPair(ofPixels &color, ofPixels &depthImage, ofFloatPixels &distance,
+		unsigned long long &colorTimestamp, unsigned long long &depthTimestamp) {
+	unsigned int colorSize = colorFrames.size();
+	unsigned int depthSize = depthFrames.size();
+
+	// Newest color frame with a depth frame within the tolerance.
+	bool bFound = false;
+	unsigned int colorIndex = 0;
+	unsigned int depthIndex = 0;
+	long long skew = 0;
+
+	for(unsigned int i = colorCount; i-- > 0 && !bFound; ) {
+		long long colorTime = colorFrames[(colorStart + i) % colorSize].timestamp;
+
+		for(unsigned int j = 0; j < depthCount; j++) {
+			long long d = (long long)depthFrames[(depthStart + j) % depthSize].timestamp - colorTime;
+			unsigned long long absSkew = (d < 0 ? -d : d);
+			if(absSkew <= tolerance && (!bFound || absSkew < (unsigned long long)(skew < 0 ? -skew : skew))) {
+				bFound = true;
+				colorIndex = i;
+				depthIndex = j;
+				skew = d;
+			}
+		}
+	}
+
+	if(!bFound) {
+		return false;
+	}
+
+	ColorFrame &colorFrame = colorFrames[(colorStart + colorIndex) % colorSize];
+	DepthFrame &depthFrame = depthFrames[(depthStart + depthIndex) % depthSize];
+
+	color.swap(colorFrame.color);
+	depthImage.swap(depthFrame.depthImage);
+	distance.swap(depthFrame.distance);
+	colorTimestamp = colorFrame.timestamp;
+	depthTimestamp = depthFrame.timestamp;
+
+	// The pair and all older frames leave the histories.
+	statistics.numDroppedColorFrames += colorIndex;
+	statistics.numDroppedDepthFrames += depthIndex;
+	colorStart = (colorStart + colorIndex + 1) % colorSize;
+	colorCount -= colorIndex + 1;
+	depthStart = (depthStart + depthIndex + 1) % depthSize;
+	depthCount -= depthIndex + 1;
+
+	long long absSkew = (skew < 0 ? -skew : skew);
+	statistics.numPairs++;
+	statistics.lastSkew = skew;
+	statistics.maxAbsSkew = MAX(statistics.maxAbsSkew, absSkew);
+	statistics.meanAbsSkew += (absSkew - statistics.meanAbsSkew)/statistics.numPairs;
+
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ofMain.h"
+
+struct ofxReprojectionSyncStatistics {
+	ofxReprojectionSyncStatistics();
+
+	unsigned long numPairs;
+
+	// Frames that were never paired, because a newer frame was paired or
+	// they fell out of the history.
+	unsigned long numDroppedColorFrames;
+	unsigned long numDroppedDepthFrames;
+
+	// Depth timestamp minus color timestamp of the pairs, in microseconds.
+	long long lastSkew;
+	long long maxAbsSkew;
+	double meanAbsSkew;
+};
+
+// Pairs color and depth frames that arrive separately by their capture
+// timestamps.
+//
+// The last few frames of each stream are kept. getPair() looks for the
+// newest color frame that has a depth frame within the tolerance, takes the
+// depth frame nearest to it, and removes both and all older frames from the
+// histories. So pairs are emitted in order, and as soon as a match is
+// available, without waiting for a possibly better one.
+//
+// The frame buffers are recycled: getPair() swaps the pixels of the pair
+// with the ones passed in, which are reused for later frames.
+//
+// Timestamps are in microseconds and increase in each stream. A timestamp
+// going backwards (e.g. the device restarted) clears the history of that
+// stream.
+//
+
+class ofxReprojectionFrameSynchronizer {
+public:
+	ofxReprojectionFrameSynchronizer();
+
+	// historySize frames per stream. The tolerance is the largest difference
+	// between the timestamps of a pair, default a bit over half a frame at
+	// 30 fps.
+	void setup(unsigned int historySize = 4, unsigned long long tolerance = 17000);
+	void clear();
+
+	void addColorFrame(const ofPixels &color, unsigned long long timestamp);
+	void addDepthFrame(const float *distance, const unsigned char *depthImage, int width, int height,
+			unsigned long long timestamp);
+
+	// Returns false if there is no pair within the tolerance.
+	bool getPair(ofPixels &color, ofPixels &depthImage, ofFloatPixels &distance,
+			unsigned long long &colorTimestamp, unsigned long long &depthTimestamp);
+
+	unsigned int getHistorySize() { return colorFrames.size(); }
+	unsigned long long getTolerance() { return tolerance; }
+
+	const ofxReprojectionSyncStatistics& getStatistics() { return statistics; }
+	void resetStatistics() { statistics = ofxReprojectionSyncStatistics(); }
+
+private:
+	struct ColorFrame {
+		ofPixels color;
+		unsigned long long timestamp;
+	};
+
+	struct DepthFrame {
+		ofPixels depthImage;
+		ofFloatPixels distance;
+		unsigned long long timestamp;
+	};
+
+	// Ring buffers, the frames of a stream are at (start + i) % size for
+	// i < count, oldest first.
+	vector<ColorFrame> colorFrames;
+	vector<DepthFrame> depthFrames;
+	unsigned int colorStart, colorCount;
+	unsigned int depthStart, depthCount;
+
+	unsigned long long tolerance;
+
+	ofxReprojectionSyncStatistics statistics;
+};
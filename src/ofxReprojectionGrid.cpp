@@ -0,0 +1,224 @@
+#include "ofxReprojectionGrid.h"
+
+ofxReprojectionGrid::ofxReprojectionGrid() {
+	mode = OF_PRIMITIVE_TRIANGLES;
+	bProcedural = false;
+	quadsX = 0;
+	skip = 1;
+	numVertices = 0;
+	numIndices = 0;
+}
+
+void ofxReprojectionGrid::setup(int width, int height, int skip, ofPrimitiveMode mode, bool procedural) {
+	clear();
+
+	if(mode != OF_PRIMITIVE_TRIANGLES && mode != OF_PRIMITIVE_POINTS) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionGrid::setup: only triangles and points are supported.";
+		return;
+	}
+
+	if(procedural && !isProceduralSupported()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionGrid::setup: GL_EXT_gpu_shader4 is not supported, "
+			<< "using a vertex buffer instead of the procedural grid.";
+		procedural = false;
+	}
+
+	this->mode = mode;
+	this->skip = skip = MAX(skip, 1);
+
+	// Quads start at x = 0, skip, ... < width - skip (and the same for y).
+	quadsX = MAX(0, (width - 1)/skip);
+	int quadsY = MAX(0, (height - 1)/skip);
+
+	if(procedural) {
+		// The shader computes the quad from gl_VertexID, see
+		// ofxReprojectionUtils::stringShaderGridVertexFunction.
+		bProcedural = true;
+		numVertices = quadsX*quadsY*(mode == OF_PRIMITIVE_TRIANGLES ? 6 : 1);
+		if(numVertices > 0) {
+			attributeBuffer = getAttributeBuffer(numVertices);
+		}
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionGrid: procedural, " << numVertices << " vertices for "
+			<< width << "x" << height << " (skip " << skip << ")";
+		return;
+	}
+
+	MeshKey key;
+	key.quadsX = quadsX;
+	key.quadsY = quadsY;
+	key.skip = skip;
+	key.mode = mode;
+
+	MeshCache &cache = getMeshCache();
+	MeshCache::iterator it = cache.find(key);
+	if(it != cache.end() && !it->second.expired()) {
+		mesh = ofPtr<Mesh>(it->second);
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionGrid: sharing cached grid for "
+			<< width << "x" << height << " (skip " << skip << ")";
+	} else {
+		// Drop the entries of meshes no grid uses anymore.
+		for(MeshCache::iterator jt = cache.begin(); jt != cache.end(); ) {
+			if(jt->second.expired()) {
+				cache.erase(jt++);
+			} else {
+				++jt;
+			}
+		}
+
+		mesh = makeMesh(quadsX, quadsY, skip, mode);
+		if(!mesh) {
+			return;
+		}
+		cache[key] = mesh;
+
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionGrid: " << mesh->numVertices << " vertices, "
+			<< mesh->numIndices << " indices for " << width << "x" << height << " (skip " << skip << ")";
+	}
+
+	numVertices = mesh->numVertices;
+	numIndices = mesh->numIndices;
+}
+
+ofPtr<ofxReprojectionGrid::Mesh> ofxReprojectionGrid::makeMesh(int quadsX, int quadsY, int skip, ofPrimitiveMode mode) {
+	// Points are drawn at the quad corners, triangles also use the far edges.
+	int columns = quadsX;
+	int rows = quadsY;
+	if(mode == OF_PRIMITIVE_TRIANGLES) {
+		columns = (quadsX > 0 ? quadsX + 1 : 0);
+		rows = (quadsY > 0 ? quadsY + 1 : 0);
+	}
+
+	if(columns == 0 || rows == 0) {
+		return ofPtr<Mesh>();
+	}
+
+	ofPtr<Mesh> mesh(new Mesh());
+	mesh->numIndices = 0;
+
+	vector<ofVec2f> vertices;
+	vertices.reserve(columns*rows);
+	for(int j = 0; j < rows; j++) {
+		for(int i = 0; i < columns; i++) {
+			vertices.push_back(ofVec2f(i*skip, j*skip));
+		}
+	}
+	mesh->vbo.setVertexData(&vertices[0], vertices.size(), GL_STATIC_DRAW);
+	mesh->numVertices = vertices.size();
+
+	if(mode == OF_PRIMITIVE_TRIANGLES) {
+		vector<ofIndexType> indices;
+		indices.reserve(6*quadsX*quadsY);
+		for(int j = 0; j < quadsY; j++) {
+			for(int i = 0; i < quadsX; i++) {
+				ofIndexType a = j*columns + i;   // (x, y)
+				ofIndexType b = a + 1;           // (x+skip, y)
+				ofIndexType c = a + columns;     // (x, y+skip)
+				ofIndexType d = c + 1;           // (x+skip, y+skip)
+
+				indices.push_back(a);
+				indices.push_back(d);
+				indices.push_back(c);
+
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(d);
+			}
+		}
+		mesh->vbo.setIndexData(&indices[0], indices.size(), GL_STATIC_DRAW);
+		mesh->numIndices = indices.size();
+	}
+
+	return mesh;
+}
+
+ofxReprojectionGrid::AttributeBuffer::AttributeBuffer(int size) {
+	this->size = size;
+	glGenBuffers(1, &id);
+	glBindBuffer(GL_ARRAY_BUFFER, id);
+	// The contents are never read by the shader, so they are left undefined.
+	glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ofxReprojectionGrid::AttributeBuffer::~AttributeBuffer() {
+	glDeleteBuffers(1, &id);
+}
+
+ofPtr<ofxReprojectionGrid::AttributeBuffer> ofxReprojectionGrid::getAttributeBuffer(int size) {
+	// Grids keep the buffer they got alive, a larger grid replaces the
+	// shared one for the grids set up after it.
+	static std::tr1::weak_ptr<AttributeBuffer> shared;
+
+	ofPtr<AttributeBuffer> buffer = shared.lock();
+	if(!buffer || buffer->size < size) {
+		buffer = ofPtr<AttributeBuffer>(new AttributeBuffer(size));
+		shared = buffer;
+	}
+	return buffer;
+}
+
+bool ofxReprojectionGrid::MeshKey::operator<(const MeshKey &other) const {
+	if(quadsX != other.quadsX) return quadsX < other.quadsX;
+	if(quadsY != other.quadsY) return quadsY < other.quadsY;
+	if(skip != other.skip) return skip < other.skip;
+	return mode < other.mode;
+}
+
+ofxReprojectionGrid::MeshCache& ofxReprojectionGrid::getMeshCache() {
+	static MeshCache cache;
+	return cache;
+}
+
+int ofxReprojectionGrid::getNumCachedMeshes() {
+	MeshCache &cache = getMeshCache();
+	int n = 0;
+	for(MeshCache::iterator it = cache.begin(); it != cache.end(); ++it) {
+		if(!it->second.expired()) {
+			n++;
+		}
+	}
+	return n;
+}
+
+void ofxReprojectionGrid::clear() {
+	mesh.reset();
+	attributeBuffer.reset();
+	bProcedural = false;
+	quadsX = 0;
+	numVertices = 0;
+	numIndices = 0;
+}
+
+bool ofxReprojectionGrid::isProceduralSupported() {
+	return ofGLCheckExtension("GL_EXT_gpu_shader4");
+}
+
+void ofxReprojectionGrid::setUniforms(ofxReprojectionShader &shader) {
+	if(bProcedural) {
+		shader.setUniform3f("grid", quadsX, skip, mode == OF_PRIMITIVE_TRIANGLES ? 1 : 0);
+	}
+}
+
+void ofxReprojectionGrid::draw() {
+	if(numVertices == 0) {
+		return;
+	}
+
+	if(bProcedural) {
+		// The positions come from gl_VertexID alone, attribute 0 is only
+		// enabled so that the compatibility profile emits the vertices.
+		glBindBuffer(GL_ARRAY_BUFFER, attributeBuffer->id);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 1, GL_UNSIGNED_BYTE, GL_FALSE, 0, 0);
+		glDrawArrays(mode == OF_PRIMITIVE_TRIANGLES ? GL_TRIANGLES : GL_POINTS, 0, numVertices);
+		glDisableVertexAttribArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	if(mode == OF_PRIMITIVE_TRIANGLES) {
+		mesh->vbo.drawElements(GL_TRIANGLES, numIndices);
+	} else {
+		mesh->vbo.draw(GL_POINTS, 0, numVertices);
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxReprojectionShader.h"
+
+// Regular grid of camera pixel coordinates, drawn with the depth image
+// shaders, which look up depth and color at the vertex position (x,y).
+//
+// With OF_PRIMITIVE_TRIANGLES, every grid point is one vertex, shared by the
+// up to six triangles around it through an index buffer. With
+// OF_PRIMITIVE_POINTS, every grid point is drawn as a point. Only the
+// (x,y) position is stored per vertex.
+//
+// The vertex and index data are uploaded to the GPU in setup(), and the CPU
+// copies are freed afterwards. Grids with the same width, height, skip and
+// mode share one vertex buffer, kept in a cache for as long as any grid uses
+// it. E.g. one Renderer2D per projector and the calibration 3D view all draw
+// the same buffer. Grids must be set up and drawn on the GL thread.
+//
+// With procedural set, no vertex positions are stored. The vertex shader
+// must be made with ofxReprojectionUtils::makeVertexShader(..., true), which
+// computes the position from gl_VertexID, and setUniforms() must be called
+// with the shader bound before draw(). Every triangle then has its own three
+// vertices (six per grid quad), so changing resolution or draw method
+// rebuilds no mesh. This needs GL_EXT_gpu_shader4, see
+// isProceduralSupported().
+//
+// A compatibility context only draws vertices when the vertex array or
+// generic attribute 0 is enabled, so the procedural grid still binds one
+// byte per vertex as attribute 0, which the shader ignores. That buffer is
+// shared by all procedural grids and only grows when a larger grid is set up.
+//
+
+class ofxReprojectionGrid {
+public:
+	ofxReprojectionGrid();
+
+	void setup(int width, int height, int skip = 1, ofPrimitiveMode mode = OF_PRIMITIVE_TRIANGLES,
+			bool procedural = false);
+	void clear();
+
+	void setUniforms(ofxReprojectionShader &shader);
+	void draw();
+
+	bool isAllocated() { return numVertices > 0; }
+	bool isProcedural() { return bProcedural; }
+	int getNumVertices() { return numVertices; }
+	int getNumIndices() { return numIndices; }
+
+	static bool isProceduralSupported();
+
+	// Number of vertex buffers in the cache, for checking that grids are shared.
+	static int getNumCachedMeshes();
+
+private:
+	struct Mesh {
+		ofVbo vbo;
+		int numVertices;
+		int numIndices;
+	};
+
+	// Width and height only matter through the number of quads.
+	struct MeshKey {
+		int quadsX;
+		int quadsY;
+		int skip;
+		ofPrimitiveMode mode;
+
+		bool operator<(const MeshKey &other) const;
+	};
+
+	static ofPtr<Mesh> makeMesh(int quadsX, int quadsY, int skip, ofPrimitiveMode mode);
+
+	// Placeholder attribute 0 for the procedural grid, see above.
+	struct AttributeBuffer {
+		AttributeBuffer(int size);
+		~AttributeBuffer();
+
+		GLuint id;
+		int size;
+	};
+
+	static ofPtr<AttributeBuffer> getAttributeBuffer(int size);
+
+	// Meshes are freed when the last grid using them is cleared or
+	// destroyed, and their cache entry is removed on the next lookup.
+	typedef map<MeshKey, std::tr1::weak_ptr<Mesh> > MeshCache;
+	static MeshCache &getMeshCache();
+
+	ofPtr<Mesh> mesh;
+	ofPtr<AttributeBuffer> attributeBuffer;
+	ofPrimitiveMode mode;
+	bool bProcedural;
+	int quadsX;
+	int skip;
+	int numVertices;
+	int numIndices;
+};
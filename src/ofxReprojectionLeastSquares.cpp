@@ -0,0 +1,181 @@
+#include "ofxReprojectionLeastSquares.h"
+
+#include <opencv2/core/core.hpp>
+
+void ofxReprojectionNormalEquations::clear() {
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			vv[i][j] = 0;
+		}
+		vb[i][0] = 0;
+		vb[i][1] = 0;
+	}
+	bb = 0;
+	n = 0;
+}
+
+void ofxReprojectionNormalEquations::add(const ofVec3f &camPoint, const ofVec2f &projectorPoint) {
+	double v[4] = { camPoint.x, camPoint.y, camPoint.z, 1 };
+
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			vv[i][j] += v[i]*v[j];
+		}
+		vb[i][0] += v[i]*projectorPoint.x;
+		vb[i][1] += v[i]*projectorPoint.y;
+	}
+	bb += (double)projectorPoint.x*projectorPoint.x + (double)projectorPoint.y*projectorPoint.y;
+	n++;
+}
+
+void ofxReprojectionNormalEquations::add(const vector<ofVec3f> &camPoints, const vector<ofVec2f> &projectorPoints) {
+	if(camPoints.size() != projectorPoints.size()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionNormalEquations::add called with "
+			<< camPoints.size() << " camera points and " << projectorPoints.size() << " projector points.";
+	}
+
+	unsigned int num = MIN(camPoints.size(), projectorPoints.size());
+	for(unsigned int k = 0; k < num; k++) {
+		add(camPoints[k], projectorPoints[k]);
+	}
+}
+
+void ofxReprojectionNormalEquations::add(const ofxReprojectionNormalEquations &other) {
+	for(int i = 0; i < 4; i++) {
+		for(int j = 0; j < 4; j++) {
+			vv[i][j] += other.vv[i][j];
+		}
+		vb[i][0] += other.vb[i][0];
+		vb[i][1] += other.vb[i][1];
+	}
+	bb += other.bb;
+	n += other.n;
+}
+
+bool ofxReprojectionNormalEquations::solve(double *params) const {
+	if(n < 4) {
+		return false;
+	}
+
+	// Solve for the linear part on data centered at the mean camera point,
+	// which keeps the system well conditioned even though z (in mm) is
+	// much larger than x and y (in pixels). The translation follows from
+	// the means.
+
+	double mean_v[3], mean_b[2];
+	for(int i = 0; i < 3; i++) {
+		mean_v[i] = vv[i][3] / n;
+	}
+	mean_b[0] = vb[3][0] / n;
+	mean_b[1] = vb[3][1] / n;
+
+	cv::Mat_<double> cov(3,3);
+	cv::Mat_<double> cross(3,2);
+	for(int i = 0; i < 3; i++) {
+		for(int j = 0; j < 3; j++) {
+			cov(i,j) = vv[i][j]/n - mean_v[i]*mean_v[j];
+		}
+		cross(i,0) = vb[i][0]/n - mean_v[i]*mean_b[0];
+		cross(i,1) = vb[i][1]/n - mean_v[i]*mean_b[1];
+	}
+
+	cv::Mat_<double> linear;
+	if(!cv::solve(cov, cross, linear, cv::DECOMP_CHOLESKY)) {
+		// All points on one plane (e.g. only one chessboard measurement)
+		// makes the system singular. Use the minimum norm solution.
+		cv::solve(cov, cross, linear, cv::DECOMP_SVD);
+	}
+
+	for(int r = 0; r < 2; r++) {
+		double offset = mean_b[r];
+		for(int i = 0; i < 3; i++) {
+			params[4*r + i] = linear(i,r);
+			offset -= linear(i,r)*mean_v[i];
+		}
+		params[4*r + 3] = offset;
+	}
+
+	return true;
+}
+
+double ofxReprojectionNormalEquations::getSquaredError(const double *params) const {
+	// sum |A*v - b|^2 = sum b^T*b - 2 sum a_r^T*v*b_r + sum a_r^T*v*v^T*a_r,
+	// with a_r the rows of A.
+
+	double err = bb;
+	for(int r = 0; r < 2; r++) {
+		const double *a = params + 4*r;
+		for(int i = 0; i < 4; i++) {
+			err -= 2*a[i]*vb[i][r];
+			for(int j = 0; j < 4; j++) {
+				err += a[i]*vv[i][j]*a[j];
+			}
+		}
+	}
+
+	// Rounding can make a near perfect fit slightly negative.
+	return MAX(err, 0.0);
+}
+
+double ofxReprojectionNormalEquations::getRMSError(const double *params) const {
+	if(n == 0) {
+		return 0;
+	}
+	return sqrt(getSquaredError(params)/n);
+}
+
+void ofxReprojectionLMModel::clear() {
+	camPoints.clear();
+	projectorPoints.clear();
+}
+
+void ofxReprojectionLMModel::add(const vector<ofVec3f> &newCamPoints, const vector<ofVec2f> &newProjectorPoints) {
+	unsigned int num = MIN(newCamPoints.size(), newProjectorPoints.size());
+
+	camPoints.reserve(camPoints.size() + 3*num);
+	projectorPoints.reserve(projectorPoints.size() + 2*num);
+
+	for(unsigned int k = 0; k < num; k++) {
+		camPoints.push_back(newCamPoints[k].x);
+		camPoints.push_back(newCamPoints[k].y);
+		camPoints.push_back(newCamPoints[k].z);
+		projectorPoints.push_back(newProjectorPoints[k].x);
+		projectorPoints.push_back(newProjectorPoints[k].y);
+	}
+}
+
+void ofxReprojectionLMModel::evaluate(const double *par, int m_dat, const void *data, double *fvec, int *info) {
+	const ofxReprojectionLMModel *model = (const ofxReprojectionLMModel*)data;
+	const double *v = &(model->camPoints[0]);
+	const double *b = &(model->projectorPoints[0]);
+
+	// Reprojection error in each dimension.
+	for(int i = 0; i < m_dat/2; i++) {
+		fvec[2*i + 0] = par[0]*v[0] + par[1]*v[1] + par[2]*v[2] + par[3] - b[0];
+		fvec[2*i + 1] = par[4]*v[0] + par[5]*v[1] + par[6]*v[2] + par[7] - b[1];
+		v += 3;
+		b += 2;
+	}
+}
+
+void ofxReprojectionLMModel::jacobian(const double *par, int m_dat, const void *data, double *fjac, int *info) {
+	const ofxReprojectionLMModel *model = (const ofxReprojectionLMModel*)data;
+	const double *v = &(model->camPoints[0]);
+
+	// Column j holds the derivatives with respect to par[j]. The x residuals
+	// depend on par[0..3] only, and the y residuals on par[4..7] only. The
+	// model is linear, so the Jacobian does not depend on par.
+	for(int i = 0; i < m_dat/2; i++) {
+		for(int j = 0; j < 3; j++) {
+			fjac[j*m_dat + 2*i + 0]     = v[j];
+			fjac[j*m_dat + 2*i + 1]     = 0;
+			fjac[(4+j)*m_dat + 2*i + 0] = 0;
+			fjac[(4+j)*m_dat + 2*i + 1] = v[j];
+		}
+		fjac[3*m_dat + 2*i + 0] = 1;
+		fjac[3*m_dat + 2*i + 1] = 0;
+		fjac[7*m_dat + 2*i + 0] = 0;
+		fjac[7*m_dat + 2*i + 1] = 1;
+		v += 3;
+	}
+}
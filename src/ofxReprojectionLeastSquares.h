@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Normal equations for the linear least squares fit of the 2x4 reprojection
+// matrix A, which maps a camera point (x,y,z) to a projector point b by
+//
+//     b = A * [x y z 1]^T
+//
+// The model is linear in the 8 elements of A, so the fit has a closed form
+// solution that depends only on the sums kept here. Sums for different sets
+// of points can be added together, and the squared reprojection error of any
+// matrix can be calculated from the sums without the points.
+//
+
+class ofxReprojectionNormalEquations {
+public:
+	ofxReprojectionNormalEquations() { clear(); }
+
+	void clear();
+
+	void add(const ofVec3f &camPoint, const ofVec2f &projectorPoint);
+	void add(const vector<ofVec3f> &camPoints, const vector<ofVec2f> &projectorPoints);
+	void add(const ofxReprojectionNormalEquations &other);
+
+	unsigned long getNumPoints() const { return n; }
+
+	// Solve for the 2x4 matrix, written row by row to params[8].
+	// Returns false if there are too few points to determine the matrix.
+	bool solve(double *params) const;
+
+	// Sum of squared reprojection errors, and the RMS reprojection error,
+	// of the 2x4 matrix given in params[8].
+	double getSquaredError(const double *params) const;
+	double getRMSError(const double *params) const;
+
+private:
+	// Sums over all points of v*v^T, v*b^T and b^T*b, with v = (x,y,z,1)
+	// and b = (projector x, projector y).
+	double vv[4][4];
+	double vb[4][2];
+	double bb;
+	unsigned long n;
+};
+
+// The same model as flat arrays of points, for refining a matrix with
+// Levenberg-Marquardt (lmmin.c). evaluate() and jacobian() have the signatures
+// lmmin_der() expects, with the model object itself as the data pointer:
+//
+//     lmmin_der(8, params, model.getNumResiduals(), &model,
+//         ofxReprojectionLMModel::evaluate, ofxReprojectionLMModel::jacobian, ...);
+//
+// There are two residuals (projector x and y) for each point. Neither function
+// allocates memory.
+//
+
+class ofxReprojectionLMModel {
+public:
+	void clear();
+	void add(const vector<ofVec3f> &camPoints, const vector<ofVec2f> &projectorPoints);
+
+	int getNumPoints() const { return projectorPoints.size()/2; }
+	int getNumResiduals() const { return projectorPoints.size(); }
+
+	static void evaluate(const double *par, int m_dat, const void *data, double *fvec, int *info);
+	static void jacobian(const double *par, int m_dat, const void *data, double *fjac, int *info);
+
+private:
+	// (x,y,z) for each camera point and (x,y) for each projector point.
+	vector<double> camPoints;
+	vector<double> projectorPoints;
+};
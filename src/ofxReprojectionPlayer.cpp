@@ -0,0 +1,337 @@
+#include "ofxReprojectionPlayer.h"
+
+#ifndef TARGET_WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ofxReprojectionPlayer::ofxReprojectionPlayer() {
+	data = NULL;
+	dataSize = 0;
+	index = NULL;
+	indexOffset = 0;
+	numFrames = 0;
+	width = 0;
+	height = 0;
+	bDepthCompressed = false;
+
+	mode = OFXREPROJECTIONPLAYER_MODE_REALTIME;
+	fixedStep = 33333;
+	bLoop = true;
+
+	currentFrame = 0;
+	bFramePending = false;
+	bFrameNew = false;
+	bFinished = false;
+	playTime = 0;
+	lastUpdateTime = 0;
+
+	bDistanceDirty = false;
+	bDepthTextureDirty = false;
+}
+
+ofxReprojectionPlayer::~ofxReprojectionPlayer() {
+	close();
+}
+
+bool ofxReprojectionPlayer::load(string filename) {
+	close();
+
+	string path = ofToDataPath(filename);
+
+#ifndef TARGET_WIN32
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: could not open " << path;
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ofxReprojectionRecordingHeader)) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: " << path << " is not a recording.";
+		::close(fd);
+		return false;
+	}
+	dataSize = st.st_size;
+
+	// Private and writable, so the pixels can be handed out as non-const
+	// pointers without changing the file.
+	void *mapping = mmap(NULL, dataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapping == MAP_FAILED) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: could not map " << path;
+		dataSize = 0;
+		return false;
+	}
+	data = (unsigned char*)mapping;
+#else
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	if(!file.is_open()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: could not open " << path;
+		return false;
+	}
+	file.seekg(0, ios::end);
+	dataSize = file.tellg();
+	file.seekg(0, ios::beg);
+	if(dataSize < sizeof(ofxReprojectionRecordingHeader)) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: " << path << " is not a recording.";
+		dataSize = 0;
+		return false;
+	}
+	fileData.resize(dataSize);
+	file.read((char*)&fileData[0], dataSize);
+	data = &fileData[0];
+#endif
+
+	const ofxReprojectionRecordingHeader &header = *(const ofxReprojectionRecordingHeader*)data;
+	// Version 1 has no flags, and zeros in their place. The frames are always
+	// padded to the recorder page size, so any other page size is damage.
+	if(memcmp(header.magic, ofxReprojectionRecorder::magic, sizeof(header.magic)) != 0
+			|| header.version < 1 || header.version > ofxReprojectionRecorder::version
+			|| (header.flags & ~OFXREPROJECTIONRECORDING_DEPTH_COMPRESSED) != 0
+			|| header.pageSize != ofxReprojectionRecorder::pageSize
+			|| header.width == 0 || header.height == 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: " << path << " is not a recording.";
+		close();
+		return false;
+	}
+	bDepthCompressed = (header.flags & OFXREPROJECTIONRECORDING_DEPTH_COMPRESSED) != 0;
+
+	unsigned long long frameSize = bDepthCompressed ? 0 : ofxReprojectionRecorder::getFrameSize(header.width, header.height);
+	unsigned long long indexSize = (unsigned long long)header.numFrames*sizeof(ofxReprojectionRecordingIndexEntry);
+	if(header.numFrames == 0 || header.frameSize != frameSize || header.indexOffset + indexSize > dataSize
+			|| header.indexOffset % sizeof(unsigned long long) != 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: " << path << " is empty or was not finished.";
+		close();
+		return false;
+	}
+
+	index = (const ofxReprojectionRecordingIndexEntry*)(data + header.indexOffset);
+	indexOffset = header.indexOffset;
+	numFrames = header.numFrames;
+	width = header.width;
+	height = header.height;
+
+	// The first page holds the header.
+	for(int i = 0; i < numFrames; i++) {
+		if(index[i].offset < ofxReprojectionRecorder::pageSize || index[i].offset % ofxReprojectionRecorder::pageSize != 0
+				|| !isFrameValid(i)) {
+			ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: " << path << " has an invalid frame index.";
+			close();
+			return false;
+		}
+	}
+
+	if(bDepthCompressed) {
+		distance.allocate(width, height, 1);
+	}
+	bFinished = false;
+	setFrame(0);
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionPlayer: " << numFrames << " frames of " << width << "x" << height
+		<< " in " << path;
+	return true;
+}
+
+void ofxReprojectionPlayer::close() {
+#ifndef TARGET_WIN32
+	if(data != NULL) {
+		munmap(data, dataSize);
+	}
+#else
+	fileData.clear();
+#endif
+	data = NULL;
+	dataSize = 0;
+	index = NULL;
+	indexOffset = 0;
+	numFrames = 0;
+	width = 0;
+	height = 0;
+	bDepthCompressed = false;
+	bFrameNew = false;
+	bFramePending = false;
+	bDistanceDirty = false;
+
+	color.clear();
+	depthImage.clear();
+	distance.clear();
+}
+
+void ofxReprojectionPlayer::setFrame(int frame) {
+	if(data == NULL) {
+		return;
+	}
+	frame = ofClamp(frame, 0, numFrames - 1);
+	playTime = index[frame].timestamp - index[0].timestamp;
+	lastUpdateTime = ofGetElapsedTimeMicros();
+	bFinished = false;
+	showFrame(frame);
+	bFramePending = true;
+}
+
+unsigned long long ofxReprojectionPlayer::getFrameEnd(int i) {
+	return i + 1 < numFrames ? index[i+1].offset : indexOffset;
+}
+
+bool ofxReprojectionPlayer::isFrameValid(int i) {
+	unsigned long long pixels = (unsigned long long)width*height;
+	unsigned long long start = index[i].offset;
+	unsigned long long end = getFrameEnd(i);
+	if(start > end) {
+		return false;
+	}
+	if(!bDepthCompressed) {
+		return start + ofxReprojectionRecorder::getFrameSize(width, height) <= end;
+	}
+
+	unsigned long long depthStart = start + pixels*(3 + 1);
+	if(depthStart + sizeof(ofxReprojectionRecordingDepthHeader) > end) {
+		return false;
+	}
+	const ofxReprojectionRecordingDepthHeader &depthHeader = *(const ofxReprojectionRecordingDepthHeader*)(data + depthStart);
+	if(depthStart + sizeof(ofxReprojectionRecordingDepthHeader) + depthHeader.size > end) {
+		return false;
+	}
+	return depthHeader.encoding == OFXREPROJECTIONRECORDING_DEPTH_RVL
+		|| (depthHeader.encoding == OFXREPROJECTIONRECORDING_DEPTH_FLOAT && depthHeader.size == pixels*sizeof(float));
+}
+
+unsigned long long ofxReprojectionPlayer::getTimestamp() {
+	return data != NULL ? index[currentFrame].timestamp : 0;
+}
+
+unsigned long long ofxReprojectionPlayer::getTimestamp(int frame) {
+	return data != NULL && frame >= 0 && frame < numFrames ? index[frame].timestamp : 0;
+}
+
+bool ofxReprojectionPlayer::getFrame(int frame, ofPixels &color, ofPixels &depthImage, ofFloatPixels &distance) {
+	if(data == NULL || frame < 0 || frame >= numFrames) {
+		return false;
+	}
+
+	unsigned char *pixels = data + index[frame].offset;
+	int n = width*height;
+	if(!bDepthCompressed) {
+		distance.setFromExternalPixels((float*)pixels, width, height, 1);
+		color.setFromExternalPixels(pixels + n*sizeof(float), width, height, 3);
+		depthImage.setFromExternalPixels(pixels + n*(sizeof(float) + 3), width, height, 1);
+		return true;
+	}
+
+	color.setFromExternalPixels(pixels, width, height, 3);
+	depthImage.setFromExternalPixels(pixels + n*3, width, height, 1);
+	if(distance.getWidth() != width || distance.getHeight() != height || distance.getNumChannels() != 1) {
+		distance.allocate(width, height, 1);
+	}
+	return decodeDistance(frame, distance.getPixels());
+}
+
+void ofxReprojectionPlayer::update() {
+	bFrameNew = bFramePending;
+	bFramePending = false;
+	if(data == NULL || bFrameNew || bFinished) {
+		return;
+	}
+
+	int frame = currentFrame;
+
+	if(mode == OFXREPROJECTIONPLAYER_MODE_FASTEST) {
+		frame++;
+	} else {
+		if(mode == OFXREPROJECTIONPLAYER_MODE_REALTIME) {
+			unsigned long long now = ofGetElapsedTimeMicros();
+			playTime += now - lastUpdateTime;
+			lastUpdateTime = now;
+		} else {
+			playTime += fixedStep;
+		}
+
+		// The last frame is shown for the mean frame interval.
+		unsigned long long start = index[0].timestamp;
+		unsigned long long duration = index[numFrames-1].timestamp - start;
+		unsigned long long end = duration + (numFrames > 1 ? duration/(numFrames - 1) : fixedStep);
+
+		if(playTime >= end) {
+			frame = numFrames;
+		} else {
+			while(frame + 1 < numFrames && index[frame+1].timestamp - start <= playTime) {
+				frame++;
+			}
+		}
+	}
+
+	if(frame >= numFrames) {
+		if(!bLoop) {
+			bFinished = true;
+			return;
+		}
+		frame = 0;
+		playTime = 0;
+	}
+
+	if(frame != currentFrame) {
+		showFrame(frame);
+		bFrameNew = true;
+	}
+}
+
+void ofxReprojectionPlayer::showFrame(int frame) {
+	currentFrame = frame;
+
+	unsigned char *pixels = data + index[frame].offset;
+	int n = width*height;
+	if(!bDepthCompressed) {
+		distance.setFromExternalPixels((float*)pixels, width, height, 1);
+		color.setFromExternalPixels(pixels + n*sizeof(float), width, height, 3);
+		depthImage.setFromExternalPixels(pixels + n*(sizeof(float) + 3), width, height, 1);
+	} else {
+		color.setFromExternalPixels(pixels, width, height, 3);
+		depthImage.setFromExternalPixels(pixels + n*3, width, height, 1);
+		bDistanceDirty = true;
+	}
+	bDepthTextureDirty = true;
+
+#ifndef TARGET_WIN32
+	// Start reading the next frame from disk in the background.
+	if(frame + 1 < numFrames) {
+		madvise(data + index[frame+1].offset, getFrameEnd(frame + 1) - index[frame+1].offset, MADV_WILLNEED);
+	}
+#endif
+}
+
+float* ofxReprojectionPlayer::getDistancePixels() {
+	if(bDistanceDirty) {
+		bDistanceDirty = false;
+		decodeDistance(currentFrame, distance.getPixels());
+	}
+	return distance.getPixels();
+}
+
+bool ofxReprojectionPlayer::decodeDistance(int frame, float *out) {
+	int n = width*height;
+	const unsigned char *depthData = data + index[frame].offset + n*(3 + 1);
+	const ofxReprojectionRecordingDepthHeader &depthHeader = *(const ofxReprojectionRecordingDepthHeader*)depthData;
+	depthData += sizeof(depthHeader);
+
+	if(depthHeader.encoding == OFXREPROJECTIONRECORDING_DEPTH_FLOAT) {
+		memcpy(out, depthData, n*sizeof(float));
+	} else if(!ofxReprojectionDepthCodec::decode(depthData, depthHeader.size, out, n)) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionPlayer: could not decode the depth of frame " << frame;
+		std::fill(out, out + n, 0.0f);
+		return false;
+	}
+	return true;
+}
+
+ofTexture& ofxReprojectionPlayer::getDepthTextureReference() {
+	if(bDepthTextureDirty && distance.isAllocated()) {
+		if(!depthTexture.isAllocated() || depthTexture.getWidth() != width || depthTexture.getHeight() != height) {
+			depthTexture.allocate(width, height, GL_LUMINANCE32F_ARB);
+		}
+		depthTexture.loadData(getDistancePixels(), width, height, GL_LUMINANCE);
+		bDepthTextureDirty = false;
+	}
+	return depthTexture;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxBase3DVideo.h"
+#include "ofxReprojectionRecorder.h"
+
+enum ofxReprojectionPlayerMode {
+	// Frames at the recorded times, following the clock.
+	OFXREPROJECTIONPLAYER_MODE_REALTIME,
+	// The recorded time advances by a fixed step per update().
+	OFXREPROJECTIONPLAYER_MODE_FIXEDSTEP,
+	// The next frame at every update().
+	OFXREPROJECTIONPLAYER_MODE_FASTEST,
+};
+
+// Plays a recording made by ofxReprojectionRecorder as an ofxBase3DVideo, so
+// calibration and rendering can run without the camera.
+//
+// The file is memory mapped, and the pixels of the current frame point into
+// the mapping, so no frame is copied or read before it is used. (On Windows
+// the file is read into memory instead.) The mapping is private: writing to
+// the pixels changes only this copy.
+//
+// In recordings with depth compression the distance of the current frame
+// is decoded into memory of its own when it is first asked for.
+//
+
+class ofxReprojectionPlayer : public ofxBase3DVideo {
+	public:
+		ofxReprojectionPlayer();
+		~ofxReprojectionPlayer();
+
+		bool load(string filename);
+		bool isLoaded() { return data != NULL; }
+
+		// Advance to the frame for the current time or step.
+		void update();
+		bool isFrameNew() { return bFrameNew; }
+
+		void setMode(ofxReprojectionPlayerMode m) { mode = m; lastUpdateTime = ofGetElapsedTimeMicros(); }
+		ofxReprojectionPlayerMode getMode() { return mode; }
+
+		// Recorded time per update() in the fixed step mode, in microseconds.
+		void setFixedStep(unsigned long long step) { fixedStep = step; }
+		unsigned long long getFixedStep() { return fixedStep; }
+
+		// Start over at the end of the recording (default).
+		void setLoop(bool b) { bLoop = b; }
+		bool getLoop() { return bLoop; }
+
+		void setFrame(int frame);
+		int getCurrentFrame() { return currentFrame; }
+		int getNumFrames() { return numFrames; }
+		bool isFinished() { return bFinished; }
+
+		// Recorded capture time of the current frame.
+		unsigned long long getTimestamp();
+		unsigned long long getTimestamp(int frame);
+
+		// Any frame, without changing the current one, so it can be called
+		// from several threads at once. The pixels point into the recording
+		// as for the current frame, except the distance of compressed
+		// recordings, which is decoded into distance (allocated as needed).
+		bool getFrame(int frame, ofPixels &color, ofPixels &depthImage, ofFloatPixels &distance);
+
+		int getWidth() { return width; }
+		int getHeight() { return height; }
+
+		bool isDepthCompressed() { return bDepthCompressed; }
+
+		unsigned char* getPixels() { return color.getPixels(); }
+		ofPixels& getPixelsRef() { return color; }
+		unsigned char* getDepthPixels() { return depthImage.getPixels(); }
+		float* getDistancePixels();
+		ofTexture& getDepthTextureReference();
+
+		void close();
+
+	private:
+		// Not copyable, the mapping is released in the destructor.
+		ofxReprojectionPlayer(const ofxReprojectionPlayer&);
+		ofxReprojectionPlayer& operator=(const ofxReprojectionPlayer&);
+
+		void showFrame(int frame);
+
+		// Offset where frame i ends, the next frame or the index.
+		unsigned long long getFrameEnd(int i);
+		bool isFrameValid(int i);
+
+		// Distance of a frame of a compressed recording.
+		bool decodeDistance(int frame, float *out);
+
+		unsigned char *data;
+		unsigned long long dataSize;
+#ifdef TARGET_WIN32
+		vector<unsigned char> fileData;
+#endif
+
+		const ofxReprojectionRecordingIndexEntry *index;
+		unsigned long long indexOffset;
+		int numFrames;
+		int width;
+		int height;
+		bool bDepthCompressed;
+
+		ofxReprojectionPlayerMode mode;
+		unsigned long long fixedStep;
+		bool bLoop;
+
+		int currentFrame;
+		bool bFramePending;
+		bool bFrameNew;
+		bool bFinished;
+
+		// Recorded time played so far, from the first frame, and the clock
+		// time it was last advanced in real time mode.
+		unsigned long long playTime;
+		unsigned long long lastUpdateTime;
+
+		// Point into the mapping, except the distance of compressed
+		// recordings.
+		ofPixels color;
+		ofPixels depthImage;
+		ofFloatPixels distance;
+		bool bDistanceDirty;
+
+		ofTexture depthTexture;
+		bool bDepthTextureDirty;
+};
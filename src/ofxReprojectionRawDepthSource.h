@@ -0,0 +1,20 @@
+#pragma once
+
+// Optional interface for ofxBase3DVideo implementations that get the depth
+// from the sensor as 16 bit integers (e.g. millimetres from OpenNI).
+//
+// ofxBase3DVideo only gives the depth as floats, which the camera has to
+// convert every frame. If the camera object also implements this interface,
+// ofxReprojectionRenderer2D and ofxReprojectionCalibration upload the 16 bit
+// depth as it is, with half the bandwidth, and the shaders convert it.
+//
+// getRawDepthPixels() must hold the same frame as getDistancePixels(), with
+// the same width and height as the color image.
+//
+
+class ofxReprojectionRawDepthSource {
+public:
+	virtual ~ofxReprojectionRawDepthSource() {}
+
+	virtual unsigned short* getRawDepthPixels() = 0;
+};
@@ -0,0 +1,166 @@
+#include "ofxReprojectionRecorder.h"
+
+const char ofxReprojectionRecorder::magic[4] = { 'O', 'R', 'R', 'C' };
+const unsigned int ofxReprojectionRecorder::version = 2;
+const unsigned int ofxReprojectionRecorder::pageSize = 4096;
+
+ofxReprojectionRecorder::ofxReprojectionRecorder() {
+	width = 0;
+	height = 0;
+	frameSize = 0;
+	bDepthCompressionEnabled = false;
+	bDepthCompressed = false;
+}
+
+ofxReprojectionRecorder::~ofxReprojectionRecorder() {
+	close();
+}
+
+unsigned long long ofxReprojectionRecorder::getFrameSize(int width, int height) {
+	unsigned long long size = (unsigned long long)width*height*(sizeof(float) + 3 + 1);
+	return (size + pageSize - 1)/pageSize*pageSize;
+}
+
+bool ofxReprojectionRecorder::open(string filename, int width, int height) {
+	close();
+
+	if(width <= 0 || height <= 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder::open: invalid frame size "
+			<< width << "x" << height << ".";
+		return false;
+	}
+
+	this->filename = ofToDataPath(filename);
+	file.open(this->filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if(!file.is_open()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder: could not open " << this->filename;
+		return false;
+	}
+
+	this->width = width;
+	this->height = height;
+	bDepthCompressed = bDepthCompressionEnabled;
+	if(bDepthCompressed && (unsigned long long)width*height > (unsigned long long)ofxReprojectionDepthCodec::maxPixels) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder: " << width << "x" << height
+			<< " frames are too large for depth compression, recording without it.";
+		bDepthCompressed = false;
+	}
+	frameSize = bDepthCompressed ? 0 : getFrameSize(width, height);
+	index.clear();
+	padding.assign(pageSize, 0);
+
+	if(bDepthCompressed) {
+		depthShort.resize(width*height);
+		depthEncoded.resize(ofxReprojectionDepthCodec::getMaxEncodedSize(width*height));
+	} else {
+		depthShort.clear();
+		depthEncoded.clear();
+	}
+
+	// The header page is written again with the frame count in close().
+	file.write(&padding[0], pageSize);
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionRecorder: recording " << width << "x" << height
+		<< " frames to " << this->filename << (bDepthCompressed ? " with depth compression" : "");
+	return true;
+}
+
+bool ofxReprojectionRecorder::addFrame(const unsigned char *color, const unsigned char *depthImage, const float *distance,
+		unsigned long long timestamp) {
+	if(!file.is_open()) {
+		return false;
+	}
+
+	ofxReprojectionRecordingIndexEntry entry;
+	entry.offset = file.tellp();
+	entry.timestamp = timestamp;
+
+	unsigned long long pixels = (unsigned long long)width*height;
+	if(!bDepthCompressed) {
+		file.write((const char*)distance, pixels*sizeof(float));
+		file.write((const char*)color, pixels*3);
+		file.write((const char*)depthImage, pixels);
+		file.write(&padding[0], frameSize - pixels*(sizeof(float) + 3 + 1));
+	} else {
+		// Distances that are not whole millimeters are stored as they are.
+		ofxReprojectionRecordingDepthHeader depthHeader;
+		if(ofxReprojectionDepthCodec::convertDepthToShort(distance, &depthShort[0], pixels)) {
+			depthHeader.encoding = OFXREPROJECTIONRECORDING_DEPTH_RVL;
+			depthHeader.size = ofxReprojectionDepthCodec::encode(&depthShort[0], pixels, &depthEncoded[0]);
+		} else {
+			depthHeader.encoding = OFXREPROJECTIONRECORDING_DEPTH_FLOAT;
+			depthHeader.size = pixels*sizeof(float);
+		}
+
+		file.write((const char*)color, pixels*3);
+		file.write((const char*)depthImage, pixels);
+		file.write((const char*)&depthHeader, sizeof(depthHeader));
+		if(depthHeader.encoding == OFXREPROJECTIONRECORDING_DEPTH_RVL) {
+			file.write((const char*)&depthEncoded[0], depthHeader.size);
+		} else {
+			file.write((const char*)distance, depthHeader.size);
+		}
+
+		unsigned long long size = pixels*(3 + 1) + sizeof(depthHeader) + depthHeader.size;
+		file.write(&padding[0], (pageSize - size % pageSize) % pageSize);
+	}
+
+	if(!file) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder: could not write frame to " << filename;
+		file.close();
+		return false;
+	}
+
+	index.push_back(entry);
+	return true;
+}
+
+bool ofxReprojectionRecorder::addFrame(ofxBase3DVideo *cam) {
+	ofPixels &color = cam->getPixelsRef();
+	if(color.getWidth() != width || color.getHeight() != height || color.getNumChannels() != 3) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder::addFrame: camera image does not match the recording.";
+		return false;
+	}
+	return addFrame(color.getPixels(), cam->getDepthPixels(), cam->getDistancePixels(), ofGetElapsedTimeMicros());
+}
+
+bool ofxReprojectionRecorder::addFrame(const ofxReprojectionCaptureFrame &frame) {
+	if(frame.color.getWidth() != width || frame.color.getHeight() != height || frame.color.getNumChannels() != 3) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder::addFrame: frame does not match the recording.";
+		return false;
+	}
+	return addFrame(frame.color.getPixels(), frame.depthImage.getPixels(), frame.distance.getPixels(), frame.timestamp);
+}
+
+void ofxReprojectionRecorder::close() {
+	if(!file.is_open()) {
+		return;
+	}
+
+	ofxReprojectionRecordingHeader header;
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.width = width;
+	header.height = height;
+	header.pageSize = pageSize;
+	header.numFrames = index.size();
+	header.frameSize = frameSize;
+	header.indexOffset = file.tellp();
+	header.flags = bDepthCompressed ? OFXREPROJECTIONRECORDING_DEPTH_COMPRESSED : 0;
+	header.reserved = 0;
+
+	if(!index.empty()) {
+		file.write((const char*)&index[0], index.size()*sizeof(ofxReprojectionRecordingIndexEntry));
+	}
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+
+	if(!file) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRecorder: could not finish " << filename;
+	} else {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionRecorder: " << index.size() << " frames in " << filename;
+	}
+
+	file.close();
+	index.clear();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxBase3DVideo.h"
+#include "ofxReprojectionCaptureThread.h"
+#include "ofxReprojectionDepthCodec.h"
+
+// Recording of camera frames, made to be memory mapped by
+// ofxReprojectionPlayer.
+//
+// The file starts with an ofxReprojectionRecordingHeader, padded to a page.
+// Then come the frames, each page aligned and padded to a whole number of
+// pages: the distance (floats), the color image (RGB) and the 8 bit depth
+// image, all of the size in the header. At the end is the frame index, one
+// ofxReprojectionRecordingIndexEntry per frame. The header and index are
+// written when the recording is closed. Values are in the byte order of the
+// machine that recorded them.
+//
+// With depth compression (OFXREPROJECTIONRECORDING_DEPTH_COMPRESSED in the
+// header flags) the frames vary in size, and the frame size in the header
+// is 0. A frame then holds the color image, the 8 bit depth image, an
+// ofxReprojectionRecordingDepthHeader and the distance as given by its
+// encoding, and ends where the next frame (or the index) starts.
+//
+
+enum {
+	OFXREPROJECTIONRECORDING_DEPTH_COMPRESSED = 1,
+};
+
+enum ofxReprojectionRecordingDepthEncoding {
+	// Floats, for distances that are not whole millimeters.
+	OFXREPROJECTIONRECORDING_DEPTH_FLOAT,
+	// 16 bit depth coded by ofxReprojectionDepthCodec.
+	OFXREPROJECTIONRECORDING_DEPTH_RVL,
+};
+
+struct ofxReprojectionRecordingHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int width;
+	unsigned int height;
+	unsigned int pageSize;
+	unsigned int numFrames;
+	unsigned long long frameSize;
+	unsigned long long indexOffset;
+	unsigned int flags;
+	unsigned int reserved;
+};
+
+struct ofxReprojectionRecordingDepthHeader {
+	unsigned int encoding;
+
+	// Bytes of distance data that follow.
+	unsigned int size;
+};
+
+struct ofxReprojectionRecordingIndexEntry {
+	// Offset of the frame from the start of the file.
+	unsigned long long offset;
+
+	// Capture time of the frame in microseconds.
+	unsigned long long timestamp;
+};
+
+class ofxReprojectionRecorder {
+public:
+	ofxReprojectionRecorder();
+	~ofxReprojectionRecorder();
+
+	// Start a new recording of frames of the given size. An existing file is
+	// replaced.
+	bool open(string filename, int width, int height);
+
+	// Compress the distance of the frames losslessly, see
+	// ofxReprojectionDepthCodec. Read by open().
+	void setDepthCompressionEnabled(bool b) { bDepthCompressionEnabled = b; }
+	bool getDepthCompressionEnabled() { return bDepthCompressionEnabled; }
+	void close();
+	bool isOpen() { return file.is_open(); }
+
+	// Append a frame. The timestamp should increase from frame to frame.
+	bool addFrame(const unsigned char *color, const unsigned char *depthImage, const float *distance,
+			unsigned long long timestamp);
+
+	// Append the current frame of the camera, with the current time.
+	bool addFrame(ofxBase3DVideo *cam);
+
+	// Append a frame from the capture thread, with its capture time.
+	bool addFrame(const ofxReprojectionCaptureFrame &frame);
+
+	unsigned int getNumFrames() { return index.size(); }
+
+	static const char magic[4];
+	static const unsigned int version;
+	static const unsigned int pageSize;
+
+	// Bytes of an uncompressed frame in a recording of the given size, padded
+	// to pages.
+	static unsigned long long getFrameSize(int width, int height);
+
+private:
+	ofstream file;
+	string filename;
+	int width;
+	int height;
+	unsigned long long frameSize;
+	bool bDepthCompressionEnabled;
+	bool bDepthCompressed;
+
+	vector<ofxReprojectionRecordingIndexEntry> index;
+	vector<char> padding;
+
+	vector<unsigned short> depthShort;
+	vector<unsigned char> depthEncoded;
+};
@@ -8,10 +8,21 @@ ofxReprojectionRenderer2D::ofxReprojectionRenderer2D()
 	useDepthImage = true;
 	pointsize = 0;
 	bPointsizeSpecified = false;
+	bGPUHueDepth = true;
+	bProceduralGrid = false;
+	bRawDepth = true;
+	rawDepthSource = NULL;
+	depthScale = 1;
+	outputgrid = &trianglesgrid;
+	shader2D = NULL;
 
 	bFirstDraw = true;
 
 	refMaxDepth = -1;
+	bAutoDepthRange = false;
+	autoDepthRangeInterval = 30;
+	autoDepthRangePercentile = 99;
+	framesSinceDepthRange = 0;
 
 	drawX = 0;
 	drawY = 0;
@@ -43,8 +54,18 @@ bool ofxReprojectionRenderer2D::init(ofxBase3DVideo *cam) {
 
 	refMaxDepth = ofxReprojectionUtils::getMaxDepth(cam->getDistancePixels(), camWidth, camHeight);
 
-	depthFloats.allocate(camWidth, camHeight, OF_IMAGE_GRAYSCALE);
-	depthFloats.getTextureReference().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+	rawDepthSource = bRawDepth ? dynamic_cast<ofxReprojectionRawDepthSource*>(cam) : NULL;
+	if(rawDepthSource != NULL) {
+		ofLogVerbose("ofxReprojection") << "Renderer uploading 16 bit depth.";
+		depthScale = ofxReprojectionUtils::allocateDepthTexture<unsigned short>(depthTexture, camWidth, camHeight);
+	} else {
+		depthScale = ofxReprojectionUtils::allocateDepthTexture<float>(depthTexture, camWidth, camHeight);
+	}
+
+	// The camera size may have changed since the grids were made.
+	pointsgrid.clear();
+	trianglesgrid.clear();
+	depthTexture.getTextureReference().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
 
 	if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_UNDEFINED) {
 		drawMethod = OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES;
@@ -63,11 +84,30 @@ void ofxReprojectionRenderer2D::update() {
 			refMaxDepth = ofxReprojectionUtils::getMaxDepth(cam->getDistancePixels(), camWidth, camHeight);
 		}
 
-		depthFloats.setFromPixels(cam->getDistancePixels(), camWidth, camHeight, OF_IMAGE_GRAYSCALE);
+		if(bAutoDepthRange && ++framesSinceDepthRange >= autoDepthRangeInterval) {
+			refMaxDepth = ofxReprojectionUtils::getRefMaxDepth(cam->getDistancePixels(), camWidth, camHeight,
+					autoDepthRangePercentile, depthStatistics);
+			framesSinceDepthRange = 0;
+		}
+
+		if(rawDepthSource != NULL) {
+			depthTexture.loadData(rawDepthSource->getRawDepthPixels());
+		} else {
+			depthTexture.loadData(cam->getDistancePixels());
+		}
 		bDepthUpdated = true;
 	}
 }
 
+void ofxReprojectionRenderer2D::setAutoDepthRange(bool enable, unsigned int interval, float percentile) {
+	bAutoDepthRange = enable;
+	autoDepthRangeInterval = interval;
+	autoDepthRangePercentile = percentile;
+
+	// Refresh at the next new frame.
+	framesSinceDepthRange = interval;
+}
+
 void ofxReprojectionRenderer2D::setKeysEnabled(bool enable) {
 	if(!bKeysEnabled && enable) {
 		ofAddListener(ofEvents().keyPressed, this, &ofxReprojectionRenderer2D::keyPressed);
@@ -85,13 +125,20 @@ void ofxReprojectionRenderer2D::keyPressed(ofKeyEventArgs& e) {
 }
 
 void ofxReprojectionRenderer2D::drawHueDepthImage() {
+	if(bGPUHueDepth) {
+		// The shaders color by depth, the depth texture is only passed as
+		// color_image to have a valid texture bound.
+		drawImage(depthTexture.getTextureReference(), true);
+		return;
+	}
+
 	if(!huetex.isAllocated()) {
 		ofLogVerbose("ofxReprojection") << "allocating ofTexture huetext in drawHueDepthImage()";
 		huetex.allocate(camWidth,camHeight, GL_RGB);
 	}
 
 	if(bDepthUpdated) {
-		ofxReprojectionUtils::makeHueDepthImage(cam->getDistancePixels(), camWidth, camHeight, refMaxDepth, huetex);
+		ofxReprojectionUtils::makeHueDepthImage(cam->getDistancePixels(), camWidth, camHeight, refMaxDepth, huetex, huePixels);
 		bDepthUpdated = false;
 	}
 	drawImage(huetex);
@@ -109,11 +156,11 @@ void ofxReprojectionRenderer2D::drawImage(ofImage &img) {
 // Needs input to be RGB image.
 void ofxReprojectionRenderer2D::drawImage(unsigned char *pixels, int pw, int ph) {
 	if(!temptex.isAllocated() || pw != temptex.getWidth() || ph != temptex.getHeight()) {
-		temptex.allocate(pw,ph,GL_RGB);
+		temptex.allocate(pw, ph, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE);
 	}
 
-	temptex.loadData(pixels,pw,ph,GL_RGB);
-	drawImage(temptex);
+	temptex.loadData(pixels);
+	drawImage(temptex.getTextureReference());
 }
 
 void ofxReprojectionRenderer2D::drawImage(ofPixels &pix) {
@@ -125,6 +172,15 @@ void ofxReprojectionRenderer2D::drawImage(ofPixels &pix) {
 }
 
 void ofxReprojectionRenderer2D::drawImage(ofTexture &tex) {
+	drawImage(tex, false);
+}
+
+void ofxReprojectionRenderer2D::drawImage(ofTexture &tex, bool hueDepth) {
+	if(shader2D == NULL) {
+		ofLogWarning("ofxReprojection") << "drawImage called before the draw method was set (see init).";
+		return;
+	}
+
 	if(bFirstDraw) {
 		bFirstDraw = false;
 		ofRectangle drawArea = ofRectangle(drawX, drawY, drawWidth, drawHeight);
@@ -158,22 +214,26 @@ void ofxReprojectionRenderer2D::drawImage(ofTexture &tex) {
 	glEnable(GL_POINT_SPRITE);
 	glEnable(GL_PROGRAM_POINT_SIZE);
 
-	shader2D.begin();
+	shader2D->begin();
 
-	shader2D.setUniform1f("pointsize",pointsize);
+	shader2D->setUniform1f("pointsize",pointsize);
 
 	if(useTransform) { 
-		shader2D.setUniformMatrix4f("transform", projectionMatrix);
+		shader2D->setUniformMatrix4f("transform", projectionMatrix);
        	} else { 
-		shader2D.setUniformMatrix4f("transform", identityMatrix); 
+		shader2D->setUniformMatrix4f("transform", identityMatrix); 
 	}
 
-	shader2D.setUniformTexture("depth_map", depthFloats, 0);
-	shader2D.setUniformTexture("color_image", tex, 1);
+	shader2D->setUniformTexture("depth_map", depthTexture.getTextureReference(), 0);
+	shader2D->setUniform1f("depth_scale", depthScale);
+	shader2D->setUniformTexture("color_image", tex, 1);
+	shader2D->setUniform1i("hue_depth", hueDepth ? 1 : 0);
+	shader2D->setUniform1f("hue_max_depth", refMaxDepth);
 
-	outputgrid.draw();
+	outputgrid->setUniforms(*shader2D);
+	outputgrid->draw();
 
-	shader2D.end();
+	shader2D->end();
 
 	output.end();
 
@@ -223,75 +283,67 @@ void ofxReprojectionRenderer2D::setDrawMethod(ofxReprojectionRenderer2DDrawMetho
 	}
 
 	//
-	// Initialize shaders
+	// Generate grid for 2D drawing. This comes first, since the grid falls
+	// back to a vertex buffer if the procedural grid is not supported. The
+	// grid of each draw method is kept, so switching back and forth does not
+	// regenerate it, and grids of the same size are shared with other
+	// renderers (see ofxReprojectionGrid).
 	//
 
-	string vshader2d,fshader2d,gshader2d;
 	if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_POINTS) {
-		vshader2d = ofxReprojectionUtils::stringVertexShader2DPoints;
-		fshader2d = ofxReprojectionUtils::stringFragmentShader2DPoints;
-		gshader2d = "";
-	} else if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES) {
-		vshader2d = ofxReprojectionUtils::stringVertexShader2DTriangles;
-		fshader2d = ofxReprojectionUtils::stringFragmentShader2DTriangles;
-		gshader2d = ofxReprojectionUtils::stringGeometryShader2DTriangles;
-	} else {
-		ofLogWarning("ofxReprojection") << "invalid rendering method!";
-		return;
-	}
-
-	ofLogVerbose("ofxReprojection") << "Renderer vertex shader string: " << vshader2d;
-	ofLogVerbose("ofxReprojection") << "Renderer fragment shader string: " << fshader2d;
-	ofLogVerbose("ofxReprojection") << "Renderer geometry shader string: " << gshader2d;
-	shader2D.setupShaderFromSource(GL_VERTEX_SHADER, vshader2d);
-	shader2D.setupShaderFromSource(GL_FRAGMENT_SHADER, fshader2d);
-	if(gshader2d != "") {
-		shader2D.setupShaderFromSource(GL_GEOMETRY_SHADER, gshader2d);
-	}
-	shader2D.linkProgram();
-	shader2D.printActiveUniforms();
-
-	if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES) {
-		shader2D.setGeometryInputType(GL_TRIANGLES);
-		shader2D.setGeometryOutputType(GL_TRIANGLES);
-		shader2D.setGeometryOutputCount(3);
+		outputgrid = &pointsgrid;
+		if(!outputgrid->isAllocated()) {
+			outputgrid->setup(camWidth, camHeight, 1, OF_PRIMITIVE_POINTS, bProceduralGrid);
+		}
+	} else if (drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES) {
+		outputgrid = &trianglesgrid;
+		if(!outputgrid->isAllocated()) {
+			outputgrid->setup(camWidth, camHeight, 1, OF_PRIMITIVE_TRIANGLES, bProceduralGrid);
+		}
 	}
 
 	//
-	// Generate grid for 2D drawing
+	// Initialize shaders. Like the grids, the program of each draw method is
+	// kept, and programs with the same sources are shared with other
+	// renderers (see ofxReprojectionShader).
 	//
 
-	outputgrid.clear();
 	if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_POINTS) {
-		outputgrid.setMode(OF_PRIMITIVE_POINTS);
-		int skip = 1;
-		for(int y = 0; y < camHeight - skip; y += skip) {
-			for(int x = 0; x < camWidth - skip; x += skip) {
-				outputgrid.addVertex(ofVec3f(x,y,2));
-				outputgrid.addTexCoord(ofVec2f(x,y));
-			}
+		if(!pointsshader) {
+			pointsshader = ofxReprojectionShader::get(
+				ofxReprojectionUtils::makeVertexShader(ofxReprojectionUtils::stringVertexShader2DPointsMain,
+					outputgrid->isProcedural()),
+				ofxReprojectionUtils::stringFragmentShader2DPoints);
 		}
-	} else if (drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES) {
-		outputgrid.setMode(OF_PRIMITIVE_TRIANGLES);
-		int skip = 1;
-		for(int y = 0; y < camHeight - skip; y += skip) {
-			for(int x = 0; x < camWidth - skip; x += skip) {
-				outputgrid.addVertex(ofVec3f(x,y,2));
-				outputgrid.addVertex(ofVec3f(x+skip,y+skip,2));
-				outputgrid.addVertex(ofVec3f(x,y+skip,2));
-
-				outputgrid.addVertex(ofVec3f(x,y,2));
-				outputgrid.addVertex(ofVec3f(x+skip,y,2));
-				outputgrid.addVertex(ofVec3f(x+skip,y+skip,2));
-
-				outputgrid.addTexCoord(ofVec2f(x,y));
-				outputgrid.addTexCoord(ofVec2f(x+skip,y+skip));
-				outputgrid.addTexCoord(ofVec2f(x,y+skip));
-
-				outputgrid.addTexCoord(ofVec2f(x,y));
-				outputgrid.addTexCoord(ofVec2f(x+skip,y));
-				outputgrid.addTexCoord(ofVec2f(x+skip,y+skip));
-			}
+		shader2D = pointsshader.get();
+	} else if(drawMethod == OFXREPROJECTIONRENDERER_2DDRAWMETHOD_TRIANGLES) {
+		if(!trianglesshader) {
+			trianglesshader = ofxReprojectionShader::get(
+				ofxReprojectionUtils::makeVertexShader(ofxReprojectionUtils::stringVertexShader2DTrianglesMain,
+					outputgrid->isProcedural()),
+				ofxReprojectionUtils::stringFragmentShader2DTriangles,
+				ofxReprojectionUtils::stringGeometryShader2DTriangles, GL_TRIANGLES, GL_TRIANGLES, 3);
 		}
+		shader2D = trianglesshader.get();
+	}
+
+	if(shader2D == NULL || !shader2D->isLoaded()) {
+		ofLogWarning("ofxReprojection") << "Renderer shader program could not be built.";
+	}
+}
+
+void ofxReprojectionRenderer2D::setProceduralGridEnabled(bool b) {
+	if(b == bProceduralGrid) return;
+	bProceduralGrid = b;
+
+	// Before init() there is nothing to rebuild yet.
+	bool bRebuild = outputgrid->isAllocated();
+	pointsgrid.clear();
+	trianglesgrid.clear();
+	pointsshader.reset();
+	trianglesshader.reset();
+	shader2D = NULL;
+	if(bRebuild) {
+		setDrawMethod(drawMethod);
 	}
 }
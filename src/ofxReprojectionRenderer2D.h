@@ -4,6 +4,10 @@
 
 #include "ofxBase3DVideo.h"
 #include "ofxHighlightRects.h"
+#include "ofxReprojectionRawDepthSource.h"
+#include "ofxReprojectionGrid.h"
+#include "ofxReprojectionShader.h"
+#include "ofxReprojectionStreamingTexture.h"
 #include "ofxReprojectionUtils.h"
 
 enum ofxReprojectionRenderer2DDrawMethod {
@@ -36,6 +40,11 @@ class ofxReprojectionRenderer2D {
 
 		void drawHueDepthImage();
 
+		// Color the hue depth image in the shaders from the depth texture
+		// (default), instead of making an RGB image on the CPU and uploading it.
+		void setGPUHueDepthEnabled(bool b) { bGPUHueDepth = b; }
+		bool getGPUHueDepthEnabled() { return bGPUHueDepth; }
+
 		void enableTransform() { useTransform = true; }
 		void disableTransform() { useTransform = false; }
 		void toggleTransform() { useTransform = !useTransform; }
@@ -43,6 +52,11 @@ class ofxReprojectionRenderer2D {
 
 		void setDrawMethod(ofxReprojectionRenderer2DDrawMethod d);
 
+		// Compute the grid positions in the vertex shader from gl_VertexID
+		// instead of drawing a vertex buffer (see ofxReprojectionGrid).
+		void setProceduralGridEnabled(bool b);
+		bool getProceduralGridEnabled() { return bProceduralGrid; }
+
 		// Enable/disable listening to openFrameworks window keypresses (t)
 		// and issuing appropriate commands during rendering stage.
 		void setKeysEnabled(bool enable);
@@ -51,12 +65,30 @@ class ofxReprojectionRenderer2D {
 
 		void setPointsize(float p) { bPointsizeSpecified = true; pointsize = p; }
 
+		// Upload the 16 bit depth when the camera implements
+		// ofxReprojectionRawDepthSource (default), instead of the float
+		// depth. Read in init().
+		void setRawDepthEnabled(bool b) { bRawDepth = b; }
+		bool getRawDepthEnabled() { return bRawDepth; }
+
+		// Recalculate the reference max depth (the hue range) every interval
+		// new frames, as the given percentile of the depth values.
+		void setAutoDepthRange(bool enable, unsigned int interval = 30, float percentile = 99);
+		int getRefMaxDepth() { return refMaxDepth; }
+
 		ofFbo& getOutputFbo() { return output; }
 
 	private:
 		ofxBase3DVideo *cam;
-		ofVboMesh outputgrid;
-		ofShader shader2D;
+		ofxReprojectionRawDepthSource *rawDepthSource;
+		bool bRawDepth;
+		float depthScale;
+		ofxReprojectionGrid pointsgrid;
+		ofxReprojectionGrid trianglesgrid;
+		ofxReprojectionGrid *outputgrid;
+		ofPtr<ofxReprojectionShader> pointsshader;
+		ofPtr<ofxReprojectionShader> trianglesshader;
+		ofxReprojectionShader *shader2D;
 		ofMatrix4x4 projectionMatrix;
 		ofMatrix4x4 identityMatrix;
 		ofColor backgroundColor;
@@ -64,6 +96,11 @@ class ofxReprojectionRenderer2D {
 		int camWidth;
 		int camHeight;
 		int refMaxDepth;
+		bool bAutoDepthRange;
+		unsigned int autoDepthRangeInterval;
+		float autoDepthRangePercentile;
+		unsigned int framesSinceDepthRange;
+		ofxReprojectionDepthStatistics depthStatistics;
 
 		bool useTransform;
 		float pointsize;
@@ -77,9 +114,10 @@ class ofxReprojectionRenderer2D {
 		ofxReprojectionRenderer2DDrawMethod drawMethod;
 
 		ofTexture huetex;
-		ofTexture temptex;
+		ofPixels huePixels;
+		ofxReprojectionStreamingTexture temptex;
 
-		ofFloatImage depthFloats;
+		ofxReprojectionStreamingTexture depthTexture;
 
 		ofFbo output;
 
@@ -89,6 +127,10 @@ class ofxReprojectionRenderer2D {
 		bool bDepthUpdated;
 
 		bool bPointsizeSpecified;
+		bool bGPUHueDepth;
+		bool bProceduralGrid;
+
+		void drawImage(ofTexture &tex, bool hueDepth);
 		
 		ofxHighlightRects highlighter;
 		bool bFirstDraw;
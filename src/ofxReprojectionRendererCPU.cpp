@@ -0,0 +1,445 @@
+#include "ofxReprojectionRendererCPU.h"
+
+#include <cfloat>
+
+#include "Poco/Environment.h"
+
+ofxReprojectionRendererCPU::ofxReprojectionRendererCPU() {
+	cam = NULL;
+	rawDepthSource = NULL;
+	bRawDepth = true;
+
+	camWidth = 0;
+	camHeight = 0;
+	outputWidth = 0;
+	outputHeight = 0;
+
+	backgroundColor = ofColor::black;
+	maxEdgeLength = 0.2;
+
+	passTask = TASK_TRANSFORM;
+	passNumber = 0;
+	numBusyWorkers = 0;
+
+	numThreads = 1;
+	setNumThreads(Poco::Environment::processorCount());
+
+	depthFloats = NULL;
+	depthShorts = NULL;
+	colorPixels = NULL;
+
+	depthCoeffX = 0;
+	depthCoeffY = 0;
+	bBaseMapDirty = true;
+
+	renderTime = 0;
+}
+
+ofxReprojectionRendererCPU::~ofxReprojectionRendererCPU() {
+	stopWorkers();
+}
+
+bool ofxReprojectionRendererCPU::init(ofxBase3DVideo *cam) {
+	if(cam == NULL) {
+		ofLogWarning("ofxReprojection") << "Valid ofxBase3DVideo providing both color "
+		       "and depth image must be passed to ofxReprojectionRendererCPU::init";
+		return false;
+	}
+
+	if(!init(cam->getPixelsRef().getWidth(), cam->getPixelsRef().getHeight())) {
+		return false;
+	}
+	this->cam = cam;
+
+	rawDepthSource = bRawDepth ? dynamic_cast<ofxReprojectionRawDepthSource*>(cam) : NULL;
+	if(rawDepthSource != NULL) {
+		ofLogVerbose("ofxReprojection") << "CPU renderer reading 16 bit depth.";
+	}
+
+	return true;
+}
+
+bool ofxReprojectionRendererCPU::init(int camWidth, int camHeight) {
+	if(camWidth < 2 || camHeight < 2) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRendererCPU::init: camera size "
+			<< camWidth << "x" << camHeight << " is too small.";
+		return false;
+	}
+
+	cam = NULL;
+	rawDepthSource = NULL;
+	this->camWidth = camWidth;
+	this->camHeight = camHeight;
+
+	baseX.resize(camWidth*camHeight);
+	baseY.resize(camWidth*camHeight);
+	bBaseMapDirty = true;
+
+	vertexX.resize(camWidth*camHeight);
+	vertexY.resize(camWidth*camHeight);
+	vertexZ.resize(camWidth*camHeight);
+	vertexValid.resize(camWidth*camHeight);
+	rowMinY.resize(camHeight);
+	rowMaxY.resize(camHeight);
+
+	return true;
+}
+
+void ofxReprojectionRendererCPU::setProjectionMatrix(ofMatrix4x4 m) {
+	projectionMatrix = m;
+	bBaseMapDirty = true;
+}
+
+void ofxReprojectionRendererCPU::setOutputSize(int w, int h) {
+	outputWidth = w;
+	outputHeight = h;
+
+	output.allocate(w, h, OF_IMAGE_COLOR);
+	output.set(0);
+	zbuffer.resize(w*h);
+	bBaseMapDirty = true;
+}
+
+void ofxReprojectionRendererCPU::setNumThreads(int n) {
+	n = MAX(n, 1);
+	if(n == numThreads && (int)workers.size() == numThreads - 1) {
+		return;
+	}
+
+	stopWorkers();
+	numThreads = n;
+	startWorkers();
+}
+
+void ofxReprojectionRendererCPU::startWorkers() {
+	for(int k = 1; k < numThreads; k++) {
+		Worker *worker = new Worker();
+		worker->renderer = this;
+		worker->begin = 0;
+		worker->end = 0;
+		// Set before the thread starts, so a pass started before it first
+		// waits is not missed.
+		worker->donePass = passNumber;
+		workers.push_back(worker);
+		worker->startThread(true, false);
+	}
+}
+
+void ofxReprojectionRendererCPU::stopWorkers() {
+	// The workers check isThreadRunning() under the mutex before waiting,
+	// so the broadcast cannot be missed.
+	workMutex.lock();
+	for(unsigned int i = 0; i < workers.size(); i++) {
+		workers[i]->stopThread();
+	}
+	workReady.broadcast();
+	workMutex.unlock();
+
+	for(unsigned int i = 0; i < workers.size(); i++) {
+		workers[i]->waitForThread(false);
+		delete workers[i];
+	}
+	workers.clear();
+}
+
+void ofxReprojectionRendererCPU::render() {
+	if(cam == NULL) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRendererCPU::render() needs a camera, see init.";
+		return;
+	}
+	render(cam->getPixelsRef());
+}
+
+void ofxReprojectionRendererCPU::render(ofPixels &pix) {
+	if(cam == NULL) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRendererCPU::render(ofPixels) needs a camera, see init.";
+		return;
+	}
+	if(pix.getNumChannels() != 3 || pix.getWidth() != camWidth || pix.getHeight() != camHeight) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRendererCPU::render(ofPixels) needs an RGB image "
+			"of the camera size.";
+		return;
+	}
+
+	if(rawDepthSource != NULL) {
+		render(NULL, rawDepthSource->getRawDepthPixels(), pix.getPixels());
+	} else {
+		render(cam->getDistancePixels(), NULL, pix.getPixels());
+	}
+}
+
+void ofxReprojectionRendererCPU::render(const float *depth, const unsigned char *rgb) {
+	render(depth, NULL, rgb);
+}
+
+void ofxReprojectionRendererCPU::render(const unsigned short *depth, const unsigned char *rgb) {
+	render(NULL, depth, rgb);
+}
+
+void ofxReprojectionRendererCPU::render(const float *depthFloats, const unsigned short *depthShorts,
+		const unsigned char *rgb) {
+	if(camWidth == 0 || outputWidth <= 0 || outputHeight <= 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionRendererCPU::render called before init and setOutputSize.";
+		return;
+	}
+
+	unsigned long long timeStart = ofGetElapsedTimeMicros();
+
+	this->depthFloats = depthFloats;
+	this->depthShorts = depthShorts;
+	this->colorPixels = rgb;
+
+	if(bBaseMapDirty) {
+		const ofMatrix4x4 &m = projectionMatrix;
+		depthCoeffX = m(0,2)*outputWidth;
+		depthCoeffY = m(1,2)*outputHeight;
+		runParallel(TASK_BASE_MAP, camHeight);
+		bBaseMapDirty = false;
+	}
+
+	runParallel(TASK_TRANSFORM, camHeight);
+	runParallel(TASK_RASTERIZE, outputHeight);
+
+	this->depthFloats = NULL;
+	this->depthShorts = NULL;
+	this->colorPixels = NULL;
+
+	renderTime = ofGetElapsedTimeMicros() - timeStart;
+}
+
+void ofxReprojectionRendererCPU::runParallel(Task task, int n) {
+	int numTasks = MIN(numThreads, n);
+
+	if(numTasks > 1) {
+		// Workers past numTasks get an empty range, but still take part in
+		// the pass so that every pass waits for the same set of threads.
+		workMutex.lock();
+		for(unsigned int k = 1; k <= workers.size(); k++) {
+			Worker *worker = workers[k-1];
+			worker->begin = ((int)k < numTasks ? k*n/numTasks : 0);
+			worker->end = ((int)k < numTasks ? (k+1)*n/numTasks : 0);
+		}
+		passTask = task;
+		passNumber++;
+		numBusyWorkers = workers.size();
+		workReady.broadcast();
+		workMutex.unlock();
+	}
+
+	runTask(task, 0, n/numTasks);
+
+	if(numTasks > 1) {
+		workMutex.lock();
+		while(numBusyWorkers > 0) {
+			passDone.wait(workMutex);
+		}
+		workMutex.unlock();
+	}
+}
+
+void ofxReprojectionRendererCPU::Worker::threadedFunction() {
+	ofMutex &mutex = renderer->workMutex;
+
+	mutex.lock();
+	while(true) {
+		while(isThreadRunning() && renderer->passNumber == donePass) {
+			renderer->workReady.wait(mutex);
+		}
+		if(!isThreadRunning()) {
+			break;
+		}
+		donePass = renderer->passNumber;
+		Task task = renderer->passTask;
+		mutex.unlock();
+
+		if(begin < end) {
+			renderer->runTask(task, begin, end);
+		}
+
+		mutex.lock();
+		renderer->numBusyWorkers--;
+		if(renderer->numBusyWorkers == 0) {
+			renderer->passDone.signal();
+		}
+	}
+	mutex.unlock();
+}
+
+void ofxReprojectionRendererCPU::runTask(Task task, int begin, int end) {
+	if(task == TASK_BASE_MAP) {
+		updateBaseMapRows(begin, end);
+	} else if(task == TASK_TRANSFORM) {
+		transformRows(begin, end);
+	} else {
+		rasterizeBand(begin, end);
+	}
+}
+
+void ofxReprojectionRendererCPU::updateBaseMapRows(int rowBegin, int rowEnd) {
+	// Projector coordinates in [0,1] are scaled to output pixels. As in the
+	// shaders, only the first two rows of the matrix are used.
+	const ofMatrix4x4 &m = projectionMatrix;
+	float ax = m(0,0)*outputWidth, bx = m(0,1)*outputWidth, dx = m(0,3)*outputWidth;
+	float ay = m(1,0)*outputHeight, by = m(1,1)*outputHeight, dy = m(1,3)*outputHeight;
+
+	for(int j = rowBegin; j < rowEnd; j++) {
+		for(int i = 0; i < camWidth; i++) {
+			int idx = j*camWidth + i;
+			baseX[idx] = ax*i + bx*j + dx;
+			baseY[idx] = ay*i + by*j + dy;
+		}
+	}
+}
+
+void ofxReprojectionRendererCPU::transformRows(int rowBegin, int rowEnd) {
+	for(int j = rowBegin; j < rowEnd; j++) {
+		float minY = FLT_MAX;
+		float maxY = -FLT_MAX;
+
+		for(int i = 0; i < camWidth; i++) {
+			int idx = j*camWidth + i;
+			float z = (depthShorts != NULL ? depthShorts[idx] : depthFloats[idx]);
+			const unsigned char *rgb = &colorPixels[3*idx];
+
+			float x = baseX[idx] + depthCoeffX*z;
+			float y = baseY[idx] + depthCoeffY*z;
+			vertexX[idx] = x;
+			vertexY[idx] = y;
+			vertexZ[idx] = z;
+
+			// The shaders make vertices without depth black, and drop
+			// triangles with a black vertex.
+			bool valid = fabs(z) >= 1e-5 && (rgb[0] != 0 || rgb[1] != 0 || rgb[2] != 0);
+			vertexValid[idx] = valid;
+			if(valid) {
+				minY = MIN(minY, y);
+				maxY = MAX(maxY, y);
+			}
+		}
+
+		rowMinY[j] = minY;
+		rowMaxY[j] = maxY;
+	}
+}
+
+void ofxReprojectionRendererCPU::rasterizeBand(int bandBegin, int bandEnd) {
+	unsigned char *pixels = output.getPixels();
+	for(int k = bandBegin*outputWidth; k < bandEnd*outputWidth; k++) {
+		pixels[3*k+0] = backgroundColor.r;
+		pixels[3*k+1] = backgroundColor.g;
+		pixels[3*k+2] = backgroundColor.b;
+		// The far plane of the ortho projection in ofxReprojectionRenderer2D.
+		zbuffer[k] = 100000;
+	}
+
+	// Pixel centers of the band are at y + 0.5.
+	float bandMinY = bandBegin + 0.5f;
+	float bandMaxY = bandEnd - 0.5f;
+
+	for(int j = 0; j < camHeight - 1; j++) {
+		if(MAX(rowMaxY[j], rowMaxY[j+1]) < bandMinY || MIN(rowMinY[j], rowMinY[j+1]) > bandMaxY) {
+			continue;
+		}
+
+		// Same triangles as the indexed grid, see ofxReprojectionGrid.
+		for(int i = 0; i < camWidth - 1; i++) {
+			int a = j*camWidth + i;   // (x, y)
+			int b = a + 1;            // (x+1, y)
+			int c = a + camWidth;     // (x, y+1)
+			int d = c + 1;            // (x+1, y+1)
+
+			rasterizeTriangle(a, d, c, bandBegin, bandEnd);
+			rasterizeTriangle(a, b, d, bandBegin, bandEnd);
+		}
+	}
+}
+
+void ofxReprojectionRendererCPU::rasterizeTriangle(int a, int b, int c, int bandBegin, int bandEnd) {
+	if(!vertexValid[a] || !vertexValid[b] || !vertexValid[c]) {
+		return;
+	}
+
+	float ax = vertexX[a], ay = vertexY[a];
+	float bx = vertexX[b], by = vertexY[b];
+	float cx = vertexX[c], cy = vertexY[c];
+
+	// Rows and columns of the pixel centers inside the bounding box.
+	int rowBegin = MAX(bandBegin, (int)ceilf(MIN(ay, MIN(by, cy)) - 0.5f));
+	int rowEnd = MIN(bandEnd - 1, (int)floorf(MAX(ay, MAX(by, cy)) - 0.5f));
+	if(rowBegin > rowEnd) {
+		return;
+	}
+	int colBegin = MAX(0, (int)ceilf(MIN(ax, MIN(bx, cx)) - 0.5f));
+	int colEnd = MIN(outputWidth - 1, (int)floorf(MAX(ax, MAX(bx, cx)) - 0.5f));
+	if(colBegin > colEnd) {
+		return;
+	}
+
+	// Side lengths in clip coordinates, as in the geometry shader.
+	float sx = 2.0f/outputWidth;
+	float sy = 2.0f/outputHeight;
+	float maxLength2 = maxEdgeLength*maxEdgeLength;
+	float abx = (bx - ax)*sx, aby = (by - ay)*sy;
+	float acx = (cx - ax)*sx, acy = (cy - ay)*sy;
+	float bcx = (cx - bx)*sx, bcy = (cy - by)*sy;
+	if(abx*abx + aby*aby >= maxLength2 || acx*acx + acy*acy >= maxLength2 || bcx*bcx + bcy*bcy >= maxLength2) {
+		return;
+	}
+
+	// The projection may mirror the image, make the triangle counter
+	// clockwise (positive area) so that inside means all edge functions >= 0.
+	float area = (bx - ax)*(cy - ay) - (by - ay)*(cx - ax);
+	if(area == 0) {
+		return;
+	}
+	if(area < 0) {
+		std::swap(b, c);
+		std::swap(bx, cx);
+		std::swap(by, cy);
+		area = -area;
+	}
+	float invArea = 1.0f/area;
+
+	// Edge functions opposite to each vertex, w0 for a, w1 for b, w2 for c,
+	// at the first pixel center, and their steps in x and y.
+	float px = colBegin + 0.5f;
+	float py = rowBegin + 0.5f;
+	float w0Row = (cx - bx)*(py - by) - (cy - by)*(px - bx);
+	float w1Row = (ax - cx)*(py - cy) - (ay - cy)*(px - cx);
+	float w2Row = (bx - ax)*(py - ay) - (by - ay)*(px - ax);
+	float w0StepX = -(cy - by), w0StepY = cx - bx;
+	float w1StepX = -(ay - cy), w1StepY = ax - cx;
+	float w2StepX = -(by - ay), w2StepY = bx - ax;
+
+	float az = vertexZ[a], bz = vertexZ[b], cz = vertexZ[c];
+	const unsigned char *ac = &colorPixels[3*a];
+	const unsigned char *bc = &colorPixels[3*b];
+	const unsigned char *cc = &colorPixels[3*c];
+
+	unsigned char *pixels = output.getPixels();
+
+	for(int y = rowBegin; y <= rowEnd; y++) {
+		float w0 = w0Row, w1 = w1Row, w2 = w2Row;
+		int k = y*outputWidth + colBegin;
+
+		for(int x = colBegin; x <= colEnd; x++, k++) {
+			if(w0 >= 0 && w1 >= 0 && w2 >= 0) {
+				float l0 = w0*invArea, l1 = w1*invArea, l2 = w2*invArea;
+				float z = l0*az + l1*bz + l2*cz;
+				if(z < zbuffer[k]) {
+					zbuffer[k] = z;
+					pixels[3*k+0] = (unsigned char)(l0*ac[0] + l1*bc[0] + l2*cc[0] + 0.5f);
+					pixels[3*k+1] = (unsigned char)(l0*ac[1] + l1*bc[1] + l2*cc[1] + 0.5f);
+					pixels[3*k+2] = (unsigned char)(l0*ac[2] + l1*bc[2] + l2*cc[2] + 0.5f);
+				}
+			}
+			w0 += w0StepX;
+			w1 += w1StepX;
+			w2 += w2StepX;
+		}
+
+		w0Row += w0StepY;
+		w1Row += w1StepY;
+		w2Row += w2StepY;
+	}
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "Poco/Condition.h"
+
+#include "ofxBase3DVideo.h"
+#include "ofxReprojectionRawDepthSource.h"
+
+// Software version of ofxReprojectionRenderer2D with the triangles draw
+// method, for machines without a GPU (or to check the output of the shaders).
+// The camera image is reprojected with the same 2x4 matrix into an RGB
+// ofPixels buffer of the projector size, without any GL calls.
+//
+// As in the shaders, each camera pixel is a vertex at (x, y, depth), and
+// neighbouring vertices form two triangles per pixel quad. The vertices are
+// transformed by the projection matrix into [0,1]x[0,1] projector
+// coordinates, and the triangles are rasterized with interpolated color and
+// a z-buffer (smaller depth in front). Like stringGeometryShader2DTriangles,
+// a triangle is dropped if a vertex has no depth or a black color, or if a
+// side is not shorter than the max edge length (in clip coordinates, where
+// the projector image is 2 units wide, so 0.2 is the same as the
+// ofxReprojectionRenderer2D default point size).
+//
+// Rendering runs in two passes, each split over the worker threads: the
+// vertices are transformed in ranges of camera rows, then the triangles are
+// rasterized into bands of output rows. Each band only writes its own rows
+// and draws the triangles in the same order, so the output does not depend
+// on the number of threads.
+//
+// The worker threads are started once, in setNumThreads(), and wait on a
+// condition between passes, so a frame costs no thread creation. Each pass
+// is handed out by bumping passNumber, and the calling thread waits until
+// all workers have finished their range before starting the next pass.
+//
+// The part of the transform that does not depend on the depth is kept per
+// camera pixel (see baseX and baseY), so a new depth frame costs one
+// multiply-add per axis and pixel. It is recalculated when the projection
+// matrix or a size changes.
+//
+
+class ofxReprojectionRendererCPU {
+	public:
+		ofxReprojectionRendererCPU();
+		~ofxReprojectionRendererCPU();
+
+		// Render the depth and color images of the camera.
+		bool init(ofxBase3DVideo *cam);
+
+		// Render depth and color buffers of the given size passed to render().
+		bool init(int camWidth, int camHeight);
+
+		void setProjectionMatrix(ofMatrix4x4 m);
+
+		// Size of the output image, in projector pixels.
+		void setOutputSize(int w, int h);
+
+		void setBackgroundColor(ofColor c) { backgroundColor = c; }
+
+		// Maximum length of a triangle side, in clip coordinates (default 0.2).
+		void setMaxEdgeLength(float l) { maxEdgeLength = l; }
+		float getMaxEdgeLength() { return maxEdgeLength; }
+
+		// Number of threads rendering, including the calling thread. Defaults
+		// to the number of processors.
+		void setNumThreads(int n);
+		int getNumThreads() { return numThreads; }
+
+		// Use the 16 bit depth when the camera implements
+		// ofxReprojectionRawDepthSource (default). Read in init().
+		void setRawDepthEnabled(bool b) { bRawDepth = b; }
+		bool getRawDepthEnabled() { return bRawDepth; }
+
+		// Render the camera color image, or another RGB image of the camera
+		// size, with the camera depth.
+		void render();
+		void render(ofPixels &pix);
+
+		// Render from buffers of the camera size, depth in the same units as
+		// ofxBase3DVideo::getDistancePixels, color RGB.
+		void render(const float *depth, const unsigned char *rgb);
+		void render(const unsigned short *depth, const unsigned char *rgb);
+
+		ofPixels& getOutputPixels() { return output; }
+
+		// Microseconds spent in the last render call.
+		unsigned long long getRenderTime() { return renderTime; }
+
+	private:
+		// Not copyable, the workers point back to the renderer.
+		ofxReprojectionRendererCPU(const ofxReprojectionRendererCPU&);
+		ofxReprojectionRendererCPU& operator=(const ofxReprojectionRendererCPU&);
+
+		enum Task {
+			TASK_BASE_MAP,
+			TASK_TRANSFORM,
+			TASK_RASTERIZE
+		};
+
+		class Worker : public ofThread {
+			public:
+				ofxReprojectionRendererCPU *renderer;
+
+				// Range of the current pass, set under the renderer mutex.
+				int begin;
+				int end;
+
+				// Last passNumber this worker has taken.
+				unsigned int donePass;
+
+			private:
+				void threadedFunction();
+		};
+		friend class Worker;
+
+		void render(const float *depthFloats, const unsigned short *depthShorts, const unsigned char *rgb);
+
+		void startWorkers();
+		void stopWorkers();
+
+		// Runs task for [0,n) split in ranges over the workers and the
+		// calling thread, and waits for all of them.
+		void runParallel(Task task, int n);
+		void runTask(Task task, int begin, int end);
+
+		void updateBaseMapRows(int rowBegin, int rowEnd);
+		void transformRows(int rowBegin, int rowEnd);
+		void rasterizeBand(int bandBegin, int bandEnd);
+		void rasterizeTriangle(int a, int b, int c, int bandBegin, int bandEnd);
+
+		ofxBase3DVideo *cam;
+		ofxReprojectionRawDepthSource *rawDepthSource;
+		bool bRawDepth;
+
+		int camWidth;
+		int camHeight;
+		int outputWidth;
+		int outputHeight;
+
+		ofMatrix4x4 projectionMatrix;
+		ofColor backgroundColor;
+		float maxEdgeLength;
+
+		int numThreads;
+		vector<Worker*> workers;
+
+		// Hands the passes to the workers. workReady is signalled when
+		// passNumber is increased (or the workers are stopped), passDone when
+		// the last worker of a pass is done and numBusyWorkers drops to 0.
+		ofMutex workMutex;
+		Poco::Condition workReady;
+		Poco::Condition passDone;
+		Task passTask;
+		unsigned int passNumber;
+		int numBusyWorkers;
+
+		// Input of the current render call, one of the depth buffers is NULL.
+		const float *depthFloats;
+		const unsigned short *depthShorts;
+		const unsigned char *colorPixels;
+
+		// Projector position of each camera pixel at depth 0, in output
+		// pixels, as structure of arrays: a0*x + a1*y + a3 for x and the same
+		// with the second matrix row for y. A vertex at depth z is then at
+		// (baseX + depthCoeffX*z, baseY + depthCoeffY*z). Rebuilt at the next
+		// render after the matrix, camera size or output size changes.
+		vector<float> baseX, baseY;
+		float depthCoeffX, depthCoeffY;
+		bool bBaseMapDirty;
+
+		// Transformed vertices (output pixel coordinates and depth) as
+		// structure of arrays, one entry per camera pixel. Vertices that drop
+		// their triangles have valid set to 0.
+		vector<float> vertexX, vertexY, vertexZ;
+		vector<unsigned char> vertexValid;
+
+		// Range of output y of the valid vertices in each camera row, to skip
+		// the rows of triangles that do not reach a band.
+		vector<float> rowMinY, rowMaxY;
+
+		vector<float> zbuffer;
+		ofPixels output;
+
+		unsigned long long renderTime;
+};
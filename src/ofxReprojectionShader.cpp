@@ -0,0 +1,371 @@
+#include "ofxReprojectionShader.h"
+
+// Header of the program binary files, followed by the binary itself.
+static const char binaryMagic[4] = { 'O', 'R', 'P', 'B' };
+static const unsigned int binaryVersion = 1;
+
+ofxReprojectionShader::ofxReprojectionShader() {
+	geometryInputType = GL_TRIANGLES;
+	geometryOutputType = GL_TRIANGLES;
+	geometryOutputCount = 3;
+	sourceHash = 0;
+
+	program = 0;
+	bLoaded = false;
+	bFromBinary = false;
+	buildTime = 0;
+}
+
+ofxReprojectionShader::~ofxReprojectionShader() {
+	unload();
+}
+
+ofPtr<ofxReprojectionShader> ofxReprojectionShader::get(const string &vertexShader, const string &fragmentShader,
+		const string &geometryShader, GLenum geometryInputType, GLenum geometryOutputType, int geometryOutputCount) {
+
+	ostringstream key;
+	key << vertexShader << '\0' << fragmentShader << '\0' << geometryShader << '\0';
+	if(geometryShader != "") {
+		key << geometryInputType << ' ' << geometryOutputType << ' ' << geometryOutputCount;
+	}
+	unsigned long long sourceHash = hash(key.str());
+
+	ProgramCache &cache = getProgramCache();
+	ProgramCache::iterator it = cache.find(sourceHash);
+	if(it != cache.end() && !it->second.expired()) {
+		ofPtr<ofxReprojectionShader> cached(it->second);
+		if(cached->vertexSource == vertexShader && cached->fragmentSource == fragmentShader
+				&& cached->geometrySource == geometryShader) {
+			ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: using cached program " << cached->program;
+			return cached;
+		}
+	}
+
+	ofPtr<ofxReprojectionShader> shader(new ofxReprojectionShader());
+	shader->vertexSource = vertexShader;
+	shader->fragmentSource = fragmentShader;
+	shader->geometrySource = geometryShader;
+	shader->geometryInputType = geometryInputType;
+	shader->geometryOutputType = geometryOutputType;
+	shader->geometryOutputCount = geometryOutputCount;
+	shader->sourceHash = sourceHash;
+
+	if(!shader->build()) {
+		return shader;
+	}
+
+	// Drop the entries of programs no one uses anymore.
+	for(ProgramCache::iterator jt = cache.begin(); jt != cache.end(); ) {
+		if(jt->second.expired()) {
+			cache.erase(jt++);
+		} else {
+			++jt;
+		}
+	}
+	cache[sourceHash] = shader;
+
+	return shader;
+}
+
+bool ofxReprojectionShader::build() {
+	unsigned long long timeStart = ofGetElapsedTimeMicros();
+
+	string path;
+	bool bUseBinary = getBinaryDirectory() != "" && isBinarySupported();
+	if(bUseBinary) {
+		char name[32];
+		sprintf(name, "%016llx.bin", sourceHash);
+		path = ofToDataPath(getBinaryDirectory() + "/" + name);
+
+		if(loadBinary(path)) {
+			buildTime = ofGetElapsedTimeMicros() - timeStart;
+			ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: loaded program binary " << path
+				<< " in " << buildTime << " us.";
+			return true;
+		}
+	}
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: vertex shader: " << vertexSource;
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: fragment shader: " << fragmentSource;
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: geometry shader: " << geometrySource;
+
+	program = glCreateProgram();
+
+	GLuint shaders[3];
+	int numShaders = 0;
+	bool bCompiled = compile(GL_VERTEX_SHADER, vertexSource, shaders[numShaders++])
+		&& compile(GL_FRAGMENT_SHADER, fragmentSource, shaders[numShaders++]);
+	if(bCompiled && geometrySource != "") {
+		bCompiled = compile(GL_GEOMETRY_SHADER_EXT, geometrySource, shaders[numShaders++]);
+
+		// Must be set before linking.
+		glProgramParameteriEXT(program, GL_GEOMETRY_INPUT_TYPE_EXT, geometryInputType);
+		glProgramParameteriEXT(program, GL_GEOMETRY_OUTPUT_TYPE_EXT, geometryOutputType);
+		glProgramParameteriEXT(program, GL_GEOMETRY_VERTICES_OUT_EXT, geometryOutputCount);
+	}
+
+	if(bCompiled) {
+		if(bUseBinary) {
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(program);
+	}
+
+	for(int i = 0; i < numShaders; i++) {
+		if(shaders[i] != 0) {
+			if(bCompiled) glDetachShader(program, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+	}
+
+	if(!bCompiled || !checkLinkStatus()) {
+		unload();
+		return false;
+	}
+
+	bLoaded = true;
+	buildTime = ofGetElapsedTimeMicros() - timeStart;
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: compiled and linked program " << program
+		<< " in " << buildTime << " us.";
+
+	if(bUseBinary) {
+		saveBinary(path);
+	}
+
+	return true;
+}
+
+bool ofxReprojectionShader::compile(GLenum type, const string &source, GLuint &shader) {
+	shader = glCreateShader(type);
+	const char *sourcePtr = source.c_str();
+	glShaderSource(shader, 1, &sourcePtr, NULL);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if(status == GL_TRUE) {
+		glAttachShader(program, shader);
+		return true;
+	}
+
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	vector<GLchar> log(MAX(logLength, 1), 0);
+	glGetShaderInfoLog(shader, log.size(), NULL, &log[0]);
+	ofLogWarning("ofxReprojection") << "ofxReprojectionShader: could not compile shader: " << &log[0];
+	return false;
+}
+
+bool ofxReprojectionShader::checkLinkStatus() {
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if(status == GL_TRUE) {
+		return true;
+	}
+
+	GLint logLength = 0;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	vector<GLchar> log(MAX(logLength, 1), 0);
+	glGetProgramInfoLog(program, log.size(), NULL, &log[0]);
+	ofLogWarning("ofxReprojection") << "ofxReprojectionShader: could not link program: " << &log[0];
+	return false;
+}
+
+bool ofxReprojectionShader::loadBinary(const string &path) {
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	if(!file.is_open()) {
+		return false;
+	}
+
+	char magic[4];
+	unsigned int version = 0;
+	unsigned long long fileDriverHash = 0;
+	unsigned long long fileSourceHash = 0;
+	GLenum format = 0;
+	unsigned int length = 0;
+
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&fileDriverHash, sizeof(fileDriverHash));
+	file.read((char*)&fileSourceHash, sizeof(fileSourceHash));
+	file.read((char*)&format, sizeof(format));
+	file.read((char*)&length, sizeof(length));
+
+	if(!file || memcmp(magic, binaryMagic, sizeof(magic)) != 0 || version != binaryVersion) {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: " << path << " is not a program binary.";
+		return false;
+	}
+	if(fileSourceHash != sourceHash || fileDriverHash != getDriverHash()) {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: " << path << " was made from other sources "
+			<< "or by another driver.";
+		return false;
+	}
+
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	vector<GLint> formats(MAX(numFormats, 1), 0);
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]);
+	if(find(formats.begin(), formats.begin() + numFormats, (GLint)format) == formats.begin() + numFormats) {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: binary format " << format
+			<< " of " << path << " is not supported by the driver.";
+		return false;
+	}
+
+	vector<char> binary(length);
+	if(length == 0 || !file.read(&binary[0], length)) {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: " << path << " is truncated.";
+		return false;
+	}
+
+	program = glCreateProgram();
+	glProgramBinary(program, format, &binary[0], length);
+	if(!checkLinkStatus()) {
+		// E.g. after a driver update that kept the version string.
+		unload();
+		return false;
+	}
+
+	bLoaded = true;
+	bFromBinary = true;
+	return true;
+}
+
+void ofxReprojectionShader::saveBinary(const string &path) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) {
+		return;
+	}
+
+	vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+
+	ofDirectory::createDirectory(getBinaryDirectory(), true, true);
+
+	ofstream file(path.c_str(), ios::out | ios::binary | ios::trunc);
+	if(!file.is_open()) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionShader: could not write program binary " << path;
+		return;
+	}
+
+	unsigned long long driverHash = getDriverHash();
+	unsigned int binaryLength = length;
+
+	file.write(binaryMagic, sizeof(binaryMagic));
+	file.write((const char*)&binaryVersion, sizeof(binaryVersion));
+	file.write((const char*)&driverHash, sizeof(driverHash));
+	file.write((const char*)&sourceHash, sizeof(sourceHash));
+	file.write((const char*)&format, sizeof(format));
+	file.write((const char*)&binaryLength, sizeof(binaryLength));
+	file.write(&binary[0], length);
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionShader: saved program binary " << path
+		<< " (" << length << " bytes).";
+}
+
+void ofxReprojectionShader::unload() {
+	if(program != 0) {
+		glDeleteProgram(program);
+		program = 0;
+	}
+	bLoaded = false;
+	bFromBinary = false;
+}
+
+bool ofxReprojectionShader::isBinarySupported() {
+	return ofGLCheckExtension("GL_ARB_get_program_binary");
+}
+
+int ofxReprojectionShader::getNumCachedPrograms() {
+	ProgramCache &cache = getProgramCache();
+	int n = 0;
+	for(ProgramCache::iterator it = cache.begin(); it != cache.end(); ++it) {
+		if(!it->second.expired()) {
+			n++;
+		}
+	}
+	return n;
+}
+
+void ofxReprojectionShader::begin() {
+	if(bLoaded) {
+		glUseProgram(program);
+	}
+}
+
+void ofxReprojectionShader::end() {
+	if(bLoaded) {
+		glUseProgram(0);
+	}
+}
+
+void ofxReprojectionShader::setUniform1i(const char *name, int v) {
+	if(bLoaded) {
+		glUniform1i(glGetUniformLocation(program, name), v);
+	}
+}
+
+void ofxReprojectionShader::setUniform1f(const char *name, float v) {
+	if(bLoaded) {
+		glUniform1f(glGetUniformLocation(program, name), v);
+	}
+}
+
+void ofxReprojectionShader::setUniform3f(const char *name, float v1, float v2, float v3) {
+	if(bLoaded) {
+		glUniform3f(glGetUniformLocation(program, name), v1, v2, v3);
+	}
+}
+
+void ofxReprojectionShader::setUniformMatrix4f(const char *name, const ofMatrix4x4 &m) {
+	if(bLoaded) {
+		glUniformMatrix4fv(glGetUniformLocation(program, name), 1, GL_FALSE, m.getPtr());
+	}
+}
+
+void ofxReprojectionShader::setUniformTexture(const char *name, ofTexture &tex, int textureLocation) {
+	if(bLoaded) {
+		ofTextureData &texData = tex.getTextureData();
+		glActiveTexture(GL_TEXTURE0 + textureLocation);
+		glEnable(texData.textureTarget);
+		glBindTexture(texData.textureTarget, texData.textureID);
+		glDisable(texData.textureTarget);
+		setUniform1i(name, textureLocation);
+		glActiveTexture(GL_TEXTURE0);
+	}
+}
+
+void ofxReprojectionShader::setUniformTexture(const char *name, ofBaseHasTexture &img, int textureLocation) {
+	setUniformTexture(name, img.getTextureReference(), textureLocation);
+}
+
+unsigned long long ofxReprojectionShader::hash(const string &s, unsigned long long h) {
+	// 64 bit FNV-1a.
+	for(unsigned int i = 0; i < s.size(); i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+unsigned long long ofxReprojectionShader::getDriverHash() {
+	GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	unsigned long long h = hash("");
+	for(int i = 0; i < 3; i++) {
+		const GLubyte *s = glGetString(names[i]);
+		h = hash(s != NULL ? string((const char*)s) : string(), h);
+		h = hash(string(1, '\0'), h);
+	}
+	return h;
+}
+
+ofxReprojectionShader::ProgramCache& ofxReprojectionShader::getProgramCache() {
+	static ProgramCache cache;
+	return cache;
+}
+
+string& ofxReprojectionShader::getBinaryDirectoryRef() {
+	static string dir;
+	return dir;
+}
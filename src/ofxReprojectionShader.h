@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ofMain.h"
+
+// GLSL program built from the shader strings in ofxReprojectionUtils, with a
+// process wide cache of linked programs.
+//
+// get() returns the program for the given sources, compiling and linking it
+// only if no other renderer or view already uses the same sources. The cache
+// keeps weak references, so a program is deleted when the last user lets go
+// of it; keep the returned pointer to keep the program.
+//
+// If a binary directory is set with setBinaryDirectory() and the driver
+// supports GL_ARB_get_program_binary, linked programs are also saved there
+// and loaded instead of compiled the next time the application starts. A
+// saved binary is only used if it was made from the same sources by the same
+// driver (GL_VENDOR, GL_RENDERER and GL_VERSION), in a binary format the
+// driver still lists, and the driver accepts it; otherwise the program is
+// compiled from source and the file replaced.
+//
+// The time spent building each program is logged (verbose), and available
+// from getBuildTime().
+//
+// The uniform functions are the ones of ofShader used in this addon, with
+// the same behaviour. All functions must be called on the GL thread.
+//
+
+class ofxReprojectionShader {
+public:
+	ofxReprojectionShader();
+	~ofxReprojectionShader();
+
+	// The geometry shader is optional; its input and output types are set
+	// with GL_EXT_geometry_shader4 before linking.
+	static ofPtr<ofxReprojectionShader> get(const string &vertexShader, const string &fragmentShader,
+			const string &geometryShader = "", GLenum geometryInputType = GL_TRIANGLES,
+			GLenum geometryOutputType = GL_TRIANGLES, int geometryOutputCount = 3);
+
+	// Directory for program binaries, relative to the data folder. Empty
+	// (the default) disables saving and loading binaries.
+	static void setBinaryDirectory(string dir) { getBinaryDirectoryRef() = dir; }
+	static string getBinaryDirectory() { return getBinaryDirectoryRef(); }
+	static bool isBinarySupported();
+
+	static int getNumCachedPrograms();
+
+	bool isLoaded() { return bLoaded; }
+	GLuint getProgram() { return program; }
+
+	// Microseconds spent compiling and linking, or loading the binary.
+	unsigned long long getBuildTime() { return buildTime; }
+	bool isLoadedFromBinary() { return bFromBinary; }
+
+	void begin();
+	void end();
+
+	void setUniform1i(const char *name, int v);
+	void setUniform1f(const char *name, float v);
+	void setUniform3f(const char *name, float v1, float v2, float v3);
+	void setUniformMatrix4f(const char *name, const ofMatrix4x4 &m);
+	void setUniformTexture(const char *name, ofTexture &tex, int textureLocation);
+	void setUniformTexture(const char *name, ofBaseHasTexture &img, int textureLocation);
+
+private:
+	// Not copyable, the GL program is deleted in the destructor.
+	ofxReprojectionShader(const ofxReprojectionShader&);
+	ofxReprojectionShader& operator=(const ofxReprojectionShader&);
+
+	bool build();
+	bool compile(GLenum type, const string &source, GLuint &shader);
+	bool checkLinkStatus();
+	bool loadBinary(const string &path);
+	void saveBinary(const string &path);
+	void unload();
+
+	static unsigned long long hash(const string &s, unsigned long long h = 14695981039346656037ULL);
+	static unsigned long long getDriverHash();
+
+	// The sources and geometry settings identify the program in the cache.
+	string vertexSource;
+	string fragmentSource;
+	string geometrySource;
+	GLenum geometryInputType;
+	GLenum geometryOutputType;
+	int geometryOutputCount;
+	unsigned long long sourceHash;
+
+	GLuint program;
+	bool bLoaded;
+	bool bFromBinary;
+	unsigned long long buildTime;
+
+	typedef map<unsigned long long, std::tr1::weak_ptr<ofxReprojectionShader> > ProgramCache;
+	static ProgramCache& getProgramCache();
+	static string& getBinaryDirectoryRef();
+};
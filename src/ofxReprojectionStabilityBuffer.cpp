@@ -0,0 +1,154 @@
+#include "ofxReprojectionStabilityBuffer.h"
+
+ofxReprojectionStabilityBuffer::ofxReprojectionStabilityBuffer() {
+	capacity = 0;
+	numCorners = 0;
+	clear();
+}
+
+void ofxReprojectionStabilityBuffer::setup(unsigned int numFrames, unsigned int numCorners) {
+	this->capacity = numFrames;
+	this->numCorners = numCorners;
+
+	x.assign(capacity*numCorners, 0);
+	y.assign(capacity*numCorners, 0);
+	z.assign(capacity*numCorners, 0);
+	frameOk.assign(capacity, false);
+
+	meanX.assign(numCorners, 0); meanY.assign(numCorners, 0);
+	meanZ.assign(numCorners, 0); meanInvZ.assign(numCorners, 0);
+	m2X.assign(numCorners, 0); m2Y.assign(numCorners, 0);
+
+	newX.assign(numCorners, 0); newY.assign(numCorners, 0); newZ.assign(numCorners, 0);
+	oldX.assign(numCorners, 0); oldY.assign(numCorners, 0); oldZ.assign(numCorners, 0);
+
+	clear();
+}
+
+void ofxReprojectionStabilityBuffer::clear() {
+	index = 0;
+	numFrames = 0;
+	numOkFrames = 0;
+	for(unsigned int k = 0; k < frameOk.size(); k++) {
+		frameOk[k] = false;
+	}
+}
+
+void ofxReprojectionStabilityBuffer::addFrame(const vector<cv::Point3f> &corners) {
+	if(capacity == 0) {
+		return;
+	}
+
+	if(!corners.empty() and corners.size() != numCorners) {
+		ofLogVerbose("ofxReprojection") << "Stability buffer: number of corners changed from "
+			<< numCorners << " to " << corners.size() << ", reallocating.";
+		setup(capacity, corners.size());
+	}
+
+	index = (index + 1) % capacity;
+
+	bool ok = !corners.empty();
+	if(frameOk[index]) numOkFrames--;
+	if(ok) numOkFrames++;
+	frameOk[index] = ok;
+
+	if(!ok) {
+		// Restart the statistics.
+		numFrames = 0;
+		return;
+	}
+
+	// When the buffer is full, the oldest frame is in the slot being overwritten.
+	if(numFrames == capacity) {
+		for(unsigned int i = 0; i < numCorners; i++) {
+			oldX[i] = x[i*capacity + index];
+			oldY[i] = y[i*capacity + index];
+			oldZ[i] = z[i*capacity + index];
+		}
+		removeStatistics();
+	}
+
+	for(unsigned int i = 0; i < numCorners; i++) {
+		newX[i] = x[i*capacity + index] = corners[i].x;
+		newY[i] = y[i*capacity + index] = corners[i].y;
+		newZ[i] = z[i*capacity + index] = corners[i].z;
+	}
+	addStatistics();
+}
+
+void ofxReprojectionStabilityBuffer::addStatistics() {
+	if(numFrames == 0) {
+		for(unsigned int i = 0; i < numCorners; i++) {
+			meanX[i] = meanY[i] = meanZ[i] = meanInvZ[i] = 0;
+			m2X[i] = m2Y[i] = 0;
+		}
+	}
+
+	numFrames++;
+	double n = numFrames;
+
+	double *mx = &meanX[0], *my = &meanY[0], *mz = &meanZ[0], *miz = &meanInvZ[0];
+	double *sx = &m2X[0], *sy = &m2Y[0];
+	const float *vx = &newX[0], *vy = &newY[0], *vz = &newZ[0];
+
+	for(unsigned int i = 0; i < numCorners; i++) {
+		double dx = vx[i] - mx[i];
+		double dy = vy[i] - my[i];
+		mx[i] += dx/n;
+		my[i] += dy/n;
+		sx[i] += dx*(vx[i] - mx[i]);
+		sy[i] += dy*(vy[i] - my[i]);
+
+		mz[i] += (vz[i] - mz[i])/n;
+		miz[i] += (1.0/vz[i] - miz[i])/n;
+	}
+}
+
+void ofxReprojectionStabilityBuffer::removeStatistics() {
+	numFrames--;
+	double n = numFrames;
+
+	if(numFrames == 0) {
+		return;
+	}
+
+	double *mx = &meanX[0], *my = &meanY[0], *mz = &meanZ[0], *miz = &meanInvZ[0];
+	double *sx = &m2X[0], *sy = &m2Y[0];
+	const float *vx = &oldX[0], *vy = &oldY[0], *vz = &oldZ[0];
+
+	for(unsigned int i = 0; i < numCorners; i++) {
+		double dx = vx[i] - mx[i];
+		double dy = vy[i] - my[i];
+		mx[i] -= dx/n;
+		my[i] -= dy/n;
+		sx[i] -= dx*(vx[i] - mx[i]);
+		sy[i] -= dy*(vy[i] - my[i]);
+
+		mz[i] -= (vz[i] - mz[i])/n;
+		miz[i] -= (1.0/vz[i] - miz[i])/n;
+	}
+}
+
+double ofxReprojectionStabilityBuffer::getLargestVarianceXY() {
+	double largest = 0;
+	for(unsigned int i = 0; numFrames > 0 && i < numCorners; i++) {
+		largest = MAX(largest, MAX(m2X[i], m2Y[i])/numFrames);
+	}
+	return largest;
+}
+
+double ofxReprojectionStabilityBuffer::getLargestVarianceZ() {
+	// mean of (z - m)^2/z = mean(z) - 2m + m^2 mean(1/z) = m (m mean(1/z) - 1)
+	double largest = 0;
+	for(unsigned int i = 0; numFrames > 0 && i < numCorners; i++) {
+		largest = MAX(largest, meanZ[i]*(meanZ[i]*meanInvZ[i] - 1));
+	}
+	return largest;
+}
+
+void ofxReprojectionStabilityBuffer::getMean(vector<ofVec3f> &mean) {
+	mean.resize(numFrames > 0 ? numCorners : 0);
+	for(unsigned int i = 0; i < mean.size(); i++) {
+		mean[i] = ofVec3f(meanX[i], meanY[i], meanZ[i]);
+	}
+}
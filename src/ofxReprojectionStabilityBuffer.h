@@ -0,0 +1,77 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include "ofMain.h"
+
+// Ring buffer of the chessboard corners from the last frames, used to check
+// that the chessboard has been held still before a measurement is accepted.
+//
+// Running means and sums of squared deviations (Welford's method) are kept for
+// each corner, and updated as frames enter and leave the ring, so the variance
+// and mean are available in O(corners) per frame.
+//
+// The x and y variance is the variance in pixels. The z variance is weighted
+// by the inverse depth, i.e. mean over frames of (z - mean z)^2 / z.
+//
+// A frame without corners restarts the sequence of frames used for the
+// statistics.
+//
+// All storage is allocated in setup(), and frames are written in place, so
+// addFrame() does not allocate memory unless the number of corners changes.
+//
+
+class ofxReprojectionStabilityBuffer {
+public:
+	ofxReprojectionStabilityBuffer();
+
+	void setup(unsigned int numFrames, unsigned int numCorners);
+	void clear();
+
+	// Add the corners of a new frame. An empty vector marks a frame where no
+	// usable chessboard was found.
+	void addFrame(const vector<cv::Point3f> &corners);
+
+	unsigned int getCapacity() { return capacity; }
+	unsigned int getNumCorners() { return numCorners; }
+
+	// Number of frames in the buffer that had corners.
+	unsigned int getNumOkFrames() { return numOkFrames; }
+
+	// True when the last getCapacity() frames all had corners.
+	bool isFull() { return capacity > 0 && numFrames == capacity; }
+
+	// Largest variance over all corners, in x/y and in z, for the frames since
+	// the last restart.
+	double getLargestVarianceXY();
+	double getLargestVarianceZ();
+
+	void getMean(vector<ofVec3f> &mean);
+
+private:
+	void addStatistics();
+	void removeStatistics();
+
+	unsigned int capacity;
+	unsigned int numCorners;
+	unsigned int index;
+
+	// Corner history as structure of arrays. The values for corner i are
+	// contiguous: x[i*capacity + slot], slot being the ring index.
+	vector<float> x, y, z;
+
+	vector<bool> frameOk;
+	unsigned int numOkFrames;
+
+	// Consecutive frames with corners, up to capacity, ending at index.
+	unsigned int numFrames;
+
+	// Per corner running mean of x, y, z and 1/z, and sums of squared
+	// deviations of x and y.
+	vector<double> meanX, meanY, meanZ, meanInvZ;
+	vector<double> m2X, m2Y;
+
+	// The frame entering (new) or leaving (old) the statistics, one value per corner.
+	vector<float> newX, newY, newZ;
+	vector<float> oldX, oldY, oldZ;
+};
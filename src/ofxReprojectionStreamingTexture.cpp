@@ -0,0 +1,219 @@
+#include "ofxReprojectionStreamingTexture.h"
+
+ofxReprojectionStreamingTexture::ofxReprojectionStreamingTexture() {
+	width = 0;
+	height = 0;
+	glFormat = GL_LUMINANCE;
+	glType = GL_FLOAT;
+	bytesPerPixel = 0;
+	bufferSize = 0;
+	currentBuffer = 0;
+	bPersistent = false;
+	bUploading = false;
+}
+
+ofxReprojectionStreamingTexture::~ofxReprojectionStreamingTexture() {
+	clear();
+}
+
+void ofxReprojectionStreamingTexture::allocate(int width, int height, int glInternalFormat, GLenum glFormat, GLenum glType,
+		int numBuffers) {
+	clear();
+
+	this->width = width;
+	this->height = height;
+	this->glFormat = glFormat;
+	this->glType = glType;
+	bytesPerPixel = getBytesPerPixel(glFormat, glType);
+	bufferSize = width*height*bytesPerPixel;
+
+	if(bufferSize == 0) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionStreamingTexture::allocate: unsupported pixel format or empty texture.";
+		return;
+	}
+
+	tex.allocate(width, height, glInternalFormat, glFormat, glType);
+
+	if(!ofGLCheckExtension("GL_ARB_pixel_buffer_object")) {
+		ofLogVerbose("ofxReprojection") << "ofxReprojectionStreamingTexture: no pixel buffer objects, "
+			<< "uploading from CPU memory.";
+		stagingPixels.resize(bufferSize);
+		return;
+	}
+
+	numBuffers = MAX(numBuffers, 1);
+	buffers.resize(numBuffers, 0);
+	fences.resize(numBuffers, (GLsync)NULL);
+	mappedBuffers.resize(numBuffers, (void*)NULL);
+	glGenBuffers(numBuffers, &buffers[0]);
+
+	bPersistent = ofGLCheckExtension("GL_ARB_buffer_storage");
+
+	for(int i = 0; i < numBuffers; i++) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+		if(bPersistent) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, flags);
+			mappedBuffers[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags);
+			if(mappedBuffers[i] == NULL) {
+				ofLogWarning("ofxReprojection") << "ofxReprojectionStreamingTexture: could not map pixel buffer, "
+					<< "uploading from CPU memory.";
+				releaseBuffers();
+				stagingPixels.resize(bufferSize);
+				return;
+			}
+		} else {
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionStreamingTexture: " << width << "x" << height << ", "
+		<< numBuffers << " pixel buffers" << (bPersistent ? ", persistently mapped." : ".");
+}
+
+void ofxReprojectionStreamingTexture::clear() {
+	if(bUploading) {
+		endUpload();
+	}
+
+	releaseBuffers();
+	stagingPixels.clear();
+	currentBuffer = 0;
+
+	if(tex.isAllocated()) {
+		tex.clear();
+	}
+	bufferSize = 0;
+}
+
+void ofxReprojectionStreamingTexture::releaseBuffers() {
+	for(unsigned int i = 0; i < buffers.size(); i++) {
+		if(fences[i] != NULL) {
+			glDeleteSync(fences[i]);
+		}
+		if(mappedBuffers[i] != NULL) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+	}
+	if(!buffers.empty()) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(buffers.size(), &buffers[0]);
+	}
+
+	buffers.clear();
+	fences.clear();
+	mappedBuffers.clear();
+	bPersistent = false;
+}
+
+void* ofxReprojectionStreamingTexture::beginUpload() {
+	if(bufferSize == 0) {
+		return NULL;
+	}
+	bUploading = true;
+
+	if(buffers.empty()) {
+		return &stagingPixels[0];
+	}
+
+	if(bPersistent) {
+		// Wait until the GPU has read the frame previously written to this
+		// buffer. With two or more buffers, that was at least a frame ago.
+		GLsync &fence = fences[currentBuffer];
+		if(fence != NULL) {
+			if(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+				ofLogWarning("ofxReprojection") << "ofxReprojectionStreamingTexture: timeout waiting for pixel buffer.";
+			}
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+		return mappedBuffers[currentBuffer];
+	}
+
+	// Orphan the buffer, so the driver does not wait for a copy from it
+	// that is still running, and map the fresh storage.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[currentBuffer]);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+	void *pixels = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if(pixels == NULL) {
+		ofLogWarning("ofxReprojection") << "ofxReprojectionStreamingTexture: could not map pixel buffer, "
+			<< "uploading from CPU memory.";
+		releaseBuffers();
+		stagingPixels.resize(bufferSize);
+		return &stagingPixels[0];
+	}
+	return pixels;
+}
+
+void ofxReprojectionStreamingTexture::endUpload() {
+	if(!bUploading) {
+		return;
+	}
+	bUploading = false;
+
+	if(buffers.empty()) {
+		tex.loadData(&stagingPixels[0], width, height, glFormat, glType);
+		return;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[currentBuffer]);
+	if(!bPersistent) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	// With a pixel buffer bound, the data argument is an offset into it,
+	// and the call returns without waiting for the copy.
+	ofTextureData &texData = tex.getTextureData();
+	glBindTexture(texData.textureTarget, texData.textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(texData.textureTarget, 0, 0, 0, width, height, glFormat, glType, (const GLvoid*)0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(texData.textureTarget, 0);
+
+	if(bPersistent) {
+		fences[currentBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	currentBuffer = (currentBuffer + 1) % buffers.size();
+}
+
+void ofxReprojectionStreamingTexture::loadData(const void *data) {
+	void *pixels = beginUpload();
+	if(pixels == NULL) {
+		return;
+	}
+	memcpy(pixels, data, bufferSize);
+	endUpload();
+}
+
+int ofxReprojectionStreamingTexture::getBytesPerPixel(GLenum glFormat, GLenum glType) {
+	int channels = 0;
+	switch(glFormat) {
+		case GL_LUMINANCE:
+		case GL_RED:
+		case GL_ALPHA:
+			channels = 1; break;
+		case GL_LUMINANCE_ALPHA:
+			channels = 2; break;
+		case GL_RGB:
+		case GL_BGR:
+			channels = 3; break;
+		case GL_RGBA:
+		case GL_BGRA:
+			channels = 4; break;
+	}
+
+	switch(glType) {
+		case GL_UNSIGNED_BYTE:
+			return channels;
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+			return 2*channels;
+		case GL_FLOAT:
+			return 4*channels;
+	}
+	return 0;
+}
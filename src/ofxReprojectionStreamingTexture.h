@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ofMain.h"
+
+// Texture that is updated every frame from the CPU (camera images) through a
+// ring of pixel buffer objects, so that the upload does not stall the render
+// thread.
+//
+// The pixels of a frame are written into one of the buffers, and
+// glTexSubImage2D copies them from there to the texture asynchronously. The
+// next frame is written into the next buffer, while the copy from the
+// previous one may still be running. Either copy the pixels in with
+// loadData(), or write them straight into the buffer between beginUpload()
+// and endUpload() (e.g. while converting them), with no other GL calls in
+// between.
+//
+// With GL_ARB_buffer_storage the buffers are mapped once, persistently, and
+// a fence per buffer makes sure the GPU is done reading a buffer before it is
+// written again. Otherwise each buffer is orphaned and mapped every frame.
+// Without pixel buffer objects, the pixels are staged in CPU memory and
+// uploaded with ofTexture::loadData.
+//
+
+class ofxReprojectionStreamingTexture {
+public:
+	ofxReprojectionStreamingTexture();
+	~ofxReprojectionStreamingTexture();
+
+	// glFormat and glType describe the pixels written, e.g. GL_LUMINANCE
+	// and GL_FLOAT. numBuffers is the length of the ring (2 or 3).
+	void allocate(int width, int height, int glInternalFormat, GLenum glFormat, GLenum glType, int numBuffers = 2);
+	void clear();
+
+	bool isAllocated() { return bufferSize > 0; }
+	int getWidth() { return width; }
+	int getHeight() { return height; }
+
+	// Pointer to width*height pixels to write the next frame to, valid until
+	// endUpload(). Returns NULL if the texture is not allocated.
+	void* beginUpload();
+	void endUpload();
+
+	void loadData(const void *data);
+
+	ofTexture& getTextureReference() { return tex; }
+
+	bool isUsingPixelBuffers() { return !buffers.empty(); }
+	bool isPersistentlyMapped() { return bPersistent; }
+
+private:
+	// Not copyable, the buffers are deleted in the destructor.
+	ofxReprojectionStreamingTexture(const ofxReprojectionStreamingTexture&);
+	ofxReprojectionStreamingTexture& operator=(const ofxReprojectionStreamingTexture&);
+
+	void releaseBuffers();
+	static int getBytesPerPixel(GLenum glFormat, GLenum glType);
+
+	ofTexture tex;
+	int width;
+	int height;
+	GLenum glFormat;
+	GLenum glType;
+	int bytesPerPixel;
+	unsigned int bufferSize;
+
+	vector<GLuint> buffers;
+	vector<GLsync> fences;
+	vector<void*> mappedBuffers;
+	unsigned int currentBuffer;
+	bool bPersistent;
+	bool bUploading;
+
+	// Staging memory when pixel buffer objects are not used.
+	vector<unsigned char> stagingPixels;
+};
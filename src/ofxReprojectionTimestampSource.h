@@ -0,0 +1,20 @@
+#pragma once
+
+// Optional interface for ofxBase3DVideo implementations that know when the
+// color and depth images were captured, e.g. from the device clock.
+//
+// The timestamps are in microseconds, on the same clock for both streams,
+// and change exactly when the image of that stream changes. If the camera
+// object implements this interface, ofxReprojectionCaptureThread pairs the
+// color and depth images by timestamp (see
+// ofxReprojectionFrameSynchronizer) instead of taking whatever both images
+// hold after an update.
+//
+
+class ofxReprojectionTimestampSource {
+public:
+	virtual ~ofxReprojectionTimestampSource() {}
+
+	virtual unsigned long long getColorTimestamp() = 0;
+	virtual unsigned long long getDepthTimestamp() = 0;
+};
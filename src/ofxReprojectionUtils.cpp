@@ -1,5 +1,9 @@
 #include "ofxReprojectionUtils.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 //
 //
 // Setup screen for rendering (orthographic projection
@@ -22,30 +26,293 @@ void ofxReprojectionUtils::setupScreen(ofMatrix4x4 m) {
 	ofLoadIdentityMatrix();
 }
 
+//
+//
+// Hue colors for depth images
+//
+//
+
+const int ofxReprojectionUtils::hueTableSize;
+
+const unsigned char* ofxReprojectionUtils::getHueTable() {
+	static unsigned char table[3*(hueTableSize+1)];
+	static bool bTableReady = false;
+
+	if(!bTableReady) {
+		table[0] = table[1] = table[2] = 0;
+		for(int k = 0; k < hueTableSize; k++) {
+			ofColor c = ofColor::fromHsb(255.0f*k/(hueTableSize-1), 255, 255);
+			table[3*(k+1)+0] = c.r;
+			table[3*(k+1)+1] = c.g;
+			table[3*(k+1)+2] = c.b;
+		}
+		bTableReady = true;
+	}
+
+	return table;
+}
+
+void ofxReprojectionUtils::makeHueDepthPixels(const float* pixels, int n, int refMaxDepth, unsigned char *out) {
+	if(refMaxDepth <= 0) {
+		memset(out, 0, 3*n);
+		return;
+	}
+
+	const unsigned char *table = getHueTable();
+	float scale = (float)(hueTableSize-1)/refMaxDepth;
+	float maxIndex = hueTableSize-1;
+
+	int i = 0;
+
+#ifdef __SSE2__
+	// Four table indices at a time. Invalid pixels (<= 0, or NaN) are masked to index 0.
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 vmax = _mm_set1_ps(maxIndex);
+	const __m128 vhalf = _mm_set1_ps(0.5f);
+	const __m128 vzero = _mm_setzero_ps();
+	const __m128i vone = _mm_set1_epi32(1);
+	int index[4];
+
+	for(; i + 4 <= n; i += 4) {
+		__m128 p = _mm_loadu_ps(pixels + i);
+		__m128 valid = _mm_cmpgt_ps(p, vzero);
+		__m128 r = _mm_add_ps(_mm_min_ps(_mm_mul_ps(p, vscale), vmax), vhalf);
+		__m128i vindex = _mm_add_epi32(_mm_cvttps_epi32(r), vone);
+		vindex = _mm_and_si128(vindex, _mm_castps_si128(valid));
+		_mm_storeu_si128((__m128i*)index, vindex);
+
+		for(int j = 0; j < 4; j++) {
+			out[3*(i+j)+0] = table[3*index[j]+0];
+			out[3*(i+j)+1] = table[3*index[j]+1];
+			out[3*(i+j)+2] = table[3*index[j]+2];
+		}
+	}
+#endif
+
+	for(; i < n; i++) {
+		int index = 0;
+		if(pixels[i] > 0) {
+			index = 1 + (int)(MIN(pixels[i]*scale, maxIndex) + 0.5f);
+		}
+		out[3*i+0] = table[3*index+0];
+		out[3*i+1] = table[3*index+1];
+		out[3*i+2] = table[3*index+2];
+	}
+}
+
+ofFloatColor ofxReprojectionUtils::hueDepthColor(float depth, float maxDepth) {
+	if(!(depth > 0) || maxDepth <= 0) {
+		return ofFloatColor(0,0,0);
+	}
+
+	// Same as hue_depth_color in stringShaderHueDepthFunction.
+	float h = 6*ofClamp(depth/maxDepth, 0, 1);
+	float offset[3] = { 0, 4, 2 };
+	float c[3];
+	for(int i = 0; i < 3; i++) {
+		c[i] = ofClamp(fabs(fmod(h + offset[i], 6.0f) - 3) - 1, 0, 1);
+	}
+
+	return ofFloatColor(c[0], c[1], c[2]);
+}
+
+void ofxReprojectionUtils::convertDepthToFloat(const unsigned short *in, float *out, int n) {
+	int i = 0;
+
+#ifdef __SSE2__
+	// Widen eight values to 32 bit integers by interleaving with zeros, and convert.
+	const __m128i vzero = _mm_setzero_si128();
+	for(; i + 8 <= n; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, vzero)));
+		_mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, vzero)));
+	}
+#endif
+
+	for(; i < n; i++) {
+		out[i] = in[i];
+	}
+}
+
+//
+//
+// Depth range
+//
+//
+
+int ofxReprojectionUtils::logMaxDepth(int max) {
+	ofLogVerbose("ofxReprojection") << "ofxReprojectionUtils::getMaxDepth calculated to " << max; 
+	return max;
+}
+
+int ofxReprojectionUtils::getMaxDepth(const float* pixels, int width, int height) {
+	int n = width*height;
+	float max = 0;
+	int i = 0;
+
+#ifdef __SSE2__
+	// NaN pixels are ignored, as _mm_max_ps returns the second operand for NaN.
+	__m128 vmax = _mm_setzero_ps();
+	for(; i + 4 <= n; i += 4) {
+		vmax = _mm_max_ps(_mm_loadu_ps(pixels + i), vmax);
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, vmax);
+	max = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+#endif
+
+	for(; i < n; i++) {
+		if(pixels[i] > max) {
+			max = pixels[i];
+		}
+	}
+
+	return logMaxDepth(max > 0 ? (int)max : -1);
+}
+
+void ofxReprojectionUtils::getDepthStatistics(const float* pixels, int width, int height, ofxReprojectionDepthStatistics &stats) {
+	stats.clear();
+
+	int n = width*height;
+	float max = 0;
+	unsigned int *histogram = &stats.histogram[0];
+	int lastBin = stats.histogram.size()-1;
+	float binScale = 1.0f/stats.binSize;
+	int i = 0;
+
+#ifdef __SSE2__
+	// Max and bin indices four pixels at a time, the histogram counts
+	// are scattered one by one. Invalid pixels (<= 0, or NaN) get bin -1.
+	const __m128 vzero = _mm_setzero_ps();
+	const __m128 vscale = _mm_set1_ps(binScale);
+	const __m128 vlast = _mm_set1_ps(lastBin);
+	const __m128i vminusone = _mm_set1_epi32(-1);
+	__m128 vmax = _mm_setzero_ps();
+	int bin[4];
+
+	for(; i + 4 <= n; i += 4) {
+		__m128 p = _mm_loadu_ps(pixels + i);
+		__m128i valid = _mm_castps_si128(_mm_cmpgt_ps(p, vzero));
+		vmax = _mm_max_ps(p, vmax);
+
+		__m128i vbin = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(p, vscale), vlast));
+		vbin = _mm_or_si128(_mm_and_si128(valid, vbin), _mm_andnot_si128(valid, vminusone));
+		_mm_storeu_si128((__m128i*)bin, vbin);
+
+		for(int j = 0; j < 4; j++) {
+			if(bin[j] >= 0) {
+				histogram[bin[j]]++;
+				stats.numValid++;
+			}
+		}
+	}
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, vmax);
+	max = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+#endif
+
+	for(; i < n; i++) {
+		if(pixels[i] > 0) {
+			if(pixels[i] > max) {
+				max = pixels[i];
+			}
+			histogram[MIN((int)(pixels[i]*binScale), lastBin)]++;
+			stats.numValid++;
+		}
+	}
+
+	stats.max = (max > 0 ? max : -1);
+}
+
 //
 //
 // GPU Shader programs as strings
 //
 //
 
-const string ofxReprojectionUtils::stringVertexShader2DPoints = 	"#version 120\n"
-			"#extension GL_ARB_texture_rectangle : enable\n"
+// Shared start of the vertex shaders. The procedural grid header is
+// added after it when the grid is generated from gl_VertexID.
+const string ofxReprojectionUtils::stringShaderHeader = "#version 120\n"
+			"#extension GL_ARB_texture_rectangle : enable\n";
+
+const string ofxReprojectionUtils::stringShaderProceduralGridHeader =
+			"#extension GL_EXT_gpu_shader4 : require\n"
+			"#define PROCEDURAL_GRID\n";
+
+// Grid vertex position in camera pixels, from the vertex buffer of
+// ofxReprojectionGrid, or computed from gl_VertexID for the procedural grid.
+const string ofxReprojectionUtils::stringShaderGridVertexFunction = "#ifdef PROCEDURAL_GRID\n"
 			STRINGIFY(
+	// grid: quads per row, grid spacing (skip), and 1 for triangles
+	// (6 vertices per quad) or 0 for points (1 vertex per quad)
+	uniform vec3 grid;
+
+	vec4 grid_vertex() {
+		int quads_x = int(grid.x);
+		int quad = gl_VertexID;
+		ivec2 corner = ivec2(0,0);
+		if(grid.z > 0.5) {
+			quad = gl_VertexID / 6;
+			int k = gl_VertexID - 6*quad;
+			// Same triangles as the indexed grid: (0,0) (1,1) (0,1) and (0,0) (1,0) (1,1)
+			corner.x = (k == 1 || k == 4 || k == 5) ? 1 : 0;
+			corner.y = (k == 1 || k == 2 || k == 5) ? 1 : 0;
+		}
+		int qy = quad / quads_x;
+		int qx = quad - qy*quads_x;
+		return vec4(float(qx + corner.x)*grid.y, float(qy + corner.y)*grid.y, 0.0, 1.0);
+	}
+			) "\n#else\n" STRINGIFY(
+	vec4 grid_vertex() {
+		return gl_Vertex;
+	}
+			) "\n#endif\n";
+
+string ofxReprojectionUtils::makeVertexShader(const string &shaderMain, bool proceduralGrid) {
+	return stringShaderHeader
+		+ (proceduralGrid ? stringShaderProceduralGridHeader : string())
+		+ stringShaderHueDepthFunction
+		+ stringShaderGridVertexFunction
+		+ shaderMain;
+}
 
-	// depth_map: R32F format, 32 bit floats in red channel
-	// (real z values, not normalized)
+// Hue color for a depth value, same as hueDepthColor() above.
+const string ofxReprojectionUtils::stringShaderHueDepthFunction = STRINGIFY(
+	vec3 hue_depth_color(float depth, float max_depth) {
+		if(depth <= 0.0 || max_depth <= 0.0) {
+			return vec3(0,0,0);
+		}
+		float h = 6.0*clamp(depth/max_depth, 0.0, 1.0);
+		return clamp(abs(mod(h + vec3(0,4,2), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+	}
+) "\n";
+
+const string ofxReprojectionUtils::stringVertexShader2DPointsMain = STRINGIFY(
+
+	// depth_map: depth in red channel, either 32 bit floats (real z values,
+	// depth_scale 1) or normalized 16 bit integers (depth_scale 65535)
 	uniform sampler2DRect depth_map;
+	uniform float depth_scale;
 
 	// color_image: RBG format
 	uniform sampler2DRect color_image;
 
+	// hue_depth: color by depth in [0, hue_max_depth] instead of color_image
+	uniform bool hue_depth;
+	uniform float hue_max_depth;
+
 	uniform mat4 transform;
 	uniform float pointsize;
 
 	void main() {
-		vec4 pos = gl_Vertex;
-		gl_FrontColor.rgb = texture2DRect(color_image, pos.xy).rgb;
-		float z = texture2DRect(depth_map, pos.xy).r;
+		vec4 pos = grid_vertex();
+		float z = texture2DRect(depth_map, pos.xy).r * depth_scale;
+		if(hue_depth) {
+			gl_FrontColor.rgb = hue_depth_color(z, hue_max_depth);
+		} else {
+			gl_FrontColor.rgb = texture2DRect(color_image, pos.xy).rgb;
+		}
 		pos.z = z;
 		pos = pos*transform;
 		pos.z = z;
@@ -58,6 +325,9 @@ const string ofxReprojectionUtils::stringVertexShader2DPoints = 	"#version 120\n
 	}
 );
 
+const string ofxReprojectionUtils::stringVertexShader2DPoints =
+			makeVertexShader(stringVertexShader2DPointsMain, false);
+
 const string ofxReprojectionUtils::stringFragmentShader2DPoints = "#version 120\n"
 		STRINGIFY(
 	void main() {
@@ -70,23 +340,30 @@ const string ofxReprojectionUtils::stringGeometryShader2DPoints = "";
 
 
 
-const string ofxReprojectionUtils::stringVertexShader2DTriangles = 	"#version 120\n"
-			"#extension GL_ARB_texture_rectangle : enable\n" 
-			STRINGIFY(
+const string ofxReprojectionUtils::stringVertexShader2DTrianglesMain = STRINGIFY(
 
-	// depth_map: R32F format, 32 bit floats in red channel 
-	// (real z values, not normalized)
+	// depth_map: depth in red channel, either 32 bit floats (real z values,
+	// depth_scale 1) or normalized 16 bit integers (depth_scale 65535)
 	uniform sampler2DRect depth_map;
+	uniform float depth_scale;
 
 	// color_image: RBG format
 	uniform sampler2DRect color_image;
 
+	// hue_depth: color by depth in [0, hue_max_depth] instead of color_image
+	uniform bool hue_depth;
+	uniform float hue_max_depth;
+
 	uniform mat4 transform;
 
 	void main() {
-		vec4 pos = gl_Vertex;
-		gl_FrontColor.rgb = texture2DRect(color_image, pos.xy).rgb;
-		float z = texture2DRect(depth_map, pos.xy).r;
+		vec4 pos = grid_vertex();
+		float z = texture2DRect(depth_map, pos.xy).r * depth_scale;
+		if(hue_depth) {
+			gl_FrontColor.rgb = hue_depth_color(z, hue_max_depth);
+		} else {
+			gl_FrontColor.rgb = texture2DRect(color_image, pos.xy).rgb;
+		}
 		pos.z = z;
 		pos = pos*transform; 
 		pos.z = z;
@@ -97,6 +374,9 @@ const string ofxReprojectionUtils::stringVertexShader2DTriangles = 	"#version 12
 	}
 );
 
+const string ofxReprojectionUtils::stringVertexShader2DTriangles =
+			makeVertexShader(stringVertexShader2DTrianglesMain, false);
+
 const string ofxReprojectionUtils::stringFragmentShader2DTriangles = "#version 120\n"
 			STRINGIFY(
 	void main() {
@@ -138,21 +418,20 @@ const string ofxReprojectionUtils::stringGeometryShader2DTriangles = "#version 1
 			);
 
 
-const string ofxReprojectionUtils::stringVertexShaderCalibration3DView = 	"#version 120\n"
-			"#extension GL_ARB_texture_rectangle : enable\n" 
-			STRINGIFY(
+const string ofxReprojectionUtils::stringVertexShaderCalibration3DViewMain = STRINGIFY(
 
-	// depth_map: R32F format, 32 bit floats in red channel 
-	// (real z values, not normalized)
+	// depth_map: depth in red channel, either 32 bit floats (real z values,
+	// depth_scale 1) or normalized 16 bit integers (depth_scale 65535)
 	uniform sampler2DRect depth_map;
+	uniform float depth_scale;
 
 	// color_image: RBG format
 	uniform sampler2DRect color_image;
 
 	void main() {
-		vec4 pos = gl_Vertex;
+		vec4 pos = grid_vertex();
 		gl_FrontColor.rgb = texture2DRect(color_image, pos.xy).rgb;
-		float z = texture2DRect(depth_map, pos.xy).r / 20.0;
+		float z = texture2DRect(depth_map, pos.xy).r * depth_scale / 20.0;
 		pos.z = z;
 		gl_Position = gl_ModelViewProjectionMatrix * pos;
 		if(abs(pos.z) < 1e-5) {
@@ -161,6 +440,9 @@ const string ofxReprojectionUtils::stringVertexShaderCalibration3DView = 	"#vers
 	}
 );
 
+const string ofxReprojectionUtils::stringVertexShaderCalibration3DView =
+			makeVertexShader(stringVertexShaderCalibration3DViewMain, false);
+
 const string ofxReprojectionUtils::stringFragmentShaderCalibration3DView = "#version 120\n"
 			STRINGIFY(
 	void main() {
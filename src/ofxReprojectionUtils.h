@@ -2,9 +2,73 @@
 
 #include "ofMain.h"
 #include "ofxReprojectionCalibrationData.h"
+#include "ofxReprojectionStreamingTexture.h"
 
 #define STRINGIFY(A) #A
 
+// Depth histogram with numBins bins of binSize depth units each, starting at 0.
+// Depths beyond the last bin are counted in the last bin.
+//
+// getPercentile(p) returns the depth below which p percent of the valid
+// (positive) pixels are, with bin resolution. Unlike the max depth, e.g. the
+// 99th percentile is not changed by a few spurious far away pixels.
+struct ofxReprojectionDepthStatistics {
+	float max;
+	unsigned int numValid;
+
+	float binSize;
+	vector<unsigned int> histogram;
+
+	ofxReprojectionDepthStatistics(int numBins = 1024, float binSize = 16) : binSize(binSize) {
+		histogram.resize(numBins);
+		clear();
+	}
+
+	void clear() {
+		max = -1;
+		numValid = 0;
+		histogram.assign(histogram.size(), 0);
+	}
+
+	int getBin(float depth) const {
+		return MIN((int)(depth/binSize), (int)histogram.size()-1);
+	}
+
+	float getPercentile(float p) const {
+		if(numValid == 0) {
+			return -1;
+		}
+
+		double target = p/100.0*numValid;
+		unsigned int count = 0;
+		for(unsigned int i = 0; i < histogram.size(); i++) {
+			count += histogram[i];
+			if(count > 0 && count >= target) {
+				return MIN((i+1)*binSize, max);
+			}
+		}
+		return max;
+	}
+};
+
+// Texture format for depth pixels of type T, chosen at compile time. 16 bit
+// depths are uploaded as they are, to a normalized 16 bit texture, which
+// the shaders scale back with the depth_scale uniform. Float depths are
+// uploaded to a 32 bit float texture with a scale of 1.
+template<typename T> struct ofxReprojectionDepthFormat;
+
+template<> struct ofxReprojectionDepthFormat<float> {
+	static GLint getInternalFormat() { return GL_LUMINANCE32F_ARB; }
+	static GLenum getType() { return GL_FLOAT; }
+	static float getScale() { return 1; }
+};
+
+template<> struct ofxReprojectionDepthFormat<unsigned short> {
+	static GLint getInternalFormat() { return GL_LUMINANCE16; }
+	static GLenum getType() { return GL_UNSIGNED_SHORT; }
+	static float getScale() { return 65535; }
+};
+
 // Collection of static methods used in various places in ofxReprojection
 // and in projects using this addon.
 
@@ -14,6 +78,22 @@ class ofxReprojectionUtils {
 		static void setupScreen(ofxReprojectionCalibrationData &data);
 		static void setupScreen(ofMatrix4x4 m);
 
+		// Vertex shaders are put together from a header, shared functions
+		// and the main function. See makeVertexShader.
+		static const string stringShaderHeader;
+		static const string stringShaderProceduralGridHeader;
+		static const string stringShaderHueDepthFunction;
+		static const string stringShaderGridVertexFunction;
+		static const string stringVertexShader2DPointsMain;
+		static const string stringVertexShader2DTrianglesMain;
+		static const string stringVertexShaderCalibration3DViewMain;
+
+		// Complete vertex shader from one of the main functions above. With
+		// proceduralGrid, the grid vertex positions are computed from
+		// gl_VertexID (see ofxReprojectionGrid) instead of read from a
+		// vertex buffer.
+		static string makeVertexShader(const string &shaderMain, bool proceduralGrid);
+
 		static const string stringVertexShader2DPoints;
 		static const string stringFragmentShader2DPoints;
 		static const string stringGeometryShader2DPoints;
@@ -24,6 +104,15 @@ class ofxReprojectionUtils {
 		static const string stringFragmentShaderCalibration3DView;
 		static const string stringGeometryShaderCalibration3DView;
 
+		// Allocate a depth texture for depth pixels of type T (float or
+		// unsigned short, see ofxReprojectionDepthFormat). Returns the
+		// depth_scale uniform the shaders need for it.
+		template<typename T>
+		static float allocateDepthTexture(ofxReprojectionStreamingTexture &tex, int width, int height) {
+			tex.allocate(width, height, ofxReprojectionDepthFormat<T>::getInternalFormat(),
+					GL_LUMINANCE, ofxReprojectionDepthFormat<T>::getType());
+			return ofxReprojectionDepthFormat<T>::getScale();
+		}
 
 		// makeHueDepthImage:
 		// Numeric type T should contain pixels in mm (or any size really,
@@ -31,8 +120,12 @@ class ofxReprojectionUtils {
 		//
 		// Outputs a ofTexture containing the depth values represented as
 		// hue values in the range [0, refMaxDepth].
+		//
+		// The RGB image is written to huePixels, which is owned by the caller
+		// and (re)allocated only when its size does not match, before it is
+		// uploaded to the texture.
 		template<typename T>
-		static void makeHueDepthImage(T* pixels, int width, int height, int refMaxDepth, ofTexture &tex) {
+		static void makeHueDepthImage(T* pixels, int width, int height, int refMaxDepth, ofTexture &tex, ofPixels &huePixels) {
 			if(!tex.isAllocated()) {
 				ofLogWarning("ofxReprojection") << "makeHueDepthImage called with unallocated texture, allocating.";
 				tex.allocate(width, height, GL_RGB);
@@ -46,46 +139,125 @@ class ofxReprojectionUtils {
 			// Is there any way to check that the format of the texture is 
 			// already set to GL_RGB?
 
-			unsigned char *outPixels = new unsigned char[3*width*height];
+			if(!huePixels.isAllocated() || huePixels.getWidth() != width || huePixels.getHeight() != height
+					|| huePixels.getNumChannels() != 3) {
+				huePixels.allocate(width, height, OF_IMAGE_COLOR);
+			}
 
-			for(int i = 0; i < width*height; i++) {
-				ofColor c = ofColor::black;
-				float relativeDepth;
+			makeHueDepthPixels(pixels, width*height, refMaxDepth, huePixels.getPixels());
+
+			tex.loadData(huePixels.getPixels(),width,height,GL_RGB);
+		};
+
+		// Same as above, with a temporary RGB image.
+		template<typename T>
+		static void makeHueDepthImage(T* pixels, int width, int height, int refMaxDepth, ofTexture &tex) {
+			ofPixels huePixels;
+			makeHueDepthImage(pixels, width, height, refMaxDepth, tex, huePixels);
+		};
+
+		// makeHueDepthPixels:
+		// Writes the RGB hue colors for n depth values to out (3*n bytes).
+		// Depth values are quantized to one of hueTableSize steps in [0, refMaxDepth]
+		// and looked up in the table from getHueTable(). Pixels without depth
+		// (<= 0) are black, and pixels further away than refMaxDepth get the
+		// color of refMaxDepth. If refMaxDepth is not positive, all pixels are black.
+		template<typename T>
+		static void makeHueDepthPixels(const T* pixels, int n, int refMaxDepth, unsigned char *out) {
+			if(refMaxDepth <= 0) {
+				memset(out, 0, 3*n);
+				return;
+			}
+
+			const unsigned char *table = getHueTable();
+			float scale = (float)(hueTableSize-1)/refMaxDepth;
+			float maxIndex = hueTableSize-1;
+
+			for(int i = 0; i < n; i++) {
+				int index = 0;
 				if(pixels[i] > 0) {
-					relativeDepth = ((float)pixels[i])/refMaxDepth;
-					c = ofColor::fromHsb(255*relativeDepth, 255,255);
-				} else {
-					relativeDepth = 0;
+					index = 1 + (int)(MIN(pixels[i]*scale, maxIndex) + 0.5f);
 				}
-				outPixels[3*i+0] = c.r;
-				outPixels[3*i+1] = c.g;
-				outPixels[3*i+2] = c.b;
+				out[3*i+0] = table[3*index+0];
+				out[3*i+1] = table[3*index+1];
+				out[3*i+2] = table[3*index+2];
 			}
+		};
 
-			tex.loadData(outPixels,width,height,GL_RGB);
+		// Float depth images (ofxBase3DVideo::getDistancePixels) use an SSE2 loop where available.
+		static void makeHueDepthPixels(const float* pixels, int n, int refMaxDepth, unsigned char *out);
 
-			delete outPixels;
-		};
+		// RGB table of hueTableSize+1 colors: entry 0 is black (no depth), and
+		// entry 1+k has the hue 255*k/(hueTableSize-1) at full saturation and brightness.
+		static const int hueTableSize = 4096;
+		static const unsigned char* getHueTable();
+
+		// Convert n 16 bit depth values (e.g. OpenNI raw depth in mm) to
+		// floats, eight at a time with SSE2 where available.
+		static void convertDepthToFloat(const unsigned short *in, float *out, int n);
+
+		// hueDepthColor:
+		// CPU reference for the hue coloring done in the 2D shaders
+		// (ofxReprojectionRenderer2D with GPU hue depth enabled). Gives the
+		// same hues as makeHueDepthImage, but computed directly instead of
+		// from the quantized table, as the shaders do.
+		static ofFloatColor hueDepthColor(float depth, float maxDepth);
+
+		// Depth range used for hue images. Returns the max depth, or the given
+		// percentile of the depth if percentile is below 100, rounded to int,
+		// or -1 if there are no valid depth values.
+		template<typename T>
+		static int getRefMaxDepth(const T* pixels, int width, int height, float percentile, ofxReprojectionDepthStatistics &stats) {
+			if(percentile >= 100) {
+				return getMaxDepth(pixels, width, height);
+			}
 
+			getDepthStatistics(pixels, width, height, stats);
+			int refMaxDepth = (stats.numValid > 0 ? (int)ceil(stats.getPercentile(percentile)) : -1);
+
+			ofLogVerbose("ofxReprojection") << "ofxReprojectionUtils::getRefMaxDepth calculated to " << refMaxDepth
+				<< " (percentile " << percentile << ", max " << stats.max << ")";
+			return refMaxDepth;
+		};
 
 		// Find reference max depth (e.g. for hue image generation above)
 		template<typename T>
-		static int getMaxDepth(T* pixels, int width, int height) {
-			int max = 0;
+		static int getMaxDepth(const T* pixels, int width, int height) {
+			T max = 0;
 			for(int i= 0; i < width*height; i++) {
 				if(pixels[i] > max) {
-					max = (int)pixels[i];
+					max = pixels[i];
 				}
 			}
 
-			if(max == 0) {
-				max = -1;
+			return logMaxDepth(max > 0 ? (int)max : -1);
+		};
+
+		// Float depth images use an SSE2 reduction where available.
+		static int getMaxDepth(const float* pixels, int width, int height);
+
+		// Depth histogram and max depth of the positive values, found in one
+		// pass over the image. See ofxReprojectionDepthStatistics for the
+		// robust range given by the percentiles.
+		template<typename T>
+		static void getDepthStatistics(const T* pixels, int width, int height, ofxReprojectionDepthStatistics &stats) {
+			stats.clear();
+
+			T max = 0;
+			for(int i = 0; i < width*height; i++) {
+				if(pixels[i] > 0) {
+					if(pixels[i] > max) {
+						max = pixels[i];
+					}
+					stats.histogram[stats.getBin(pixels[i])]++;
+					stats.numValid++;
+				}
 			}
 
-			ofLogVerbose("ofxReprojection") << "ofxReprojectionUtils::getMaxDepth calculated to " << max; 
-			return max;
+			stats.max = (max > 0 ? (float)max : -1);
 		};
 
+		static void getDepthStatistics(const float* pixels, int width, int height, ofxReprojectionDepthStatistics &stats);
 
 
 		//
@@ -112,4 +284,7 @@ class ofxReprojectionUtils {
 			}
 			return (((*obj).*f_get)() > 0);
 		}
+
+	private:
+		static int logMaxDepth(int max);
 };